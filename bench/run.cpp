@@ -7,11 +7,11 @@ std::size_t feature_count = 0;
 
 static void decode_entire_tile(std::string const& buffer) {
     mapbox::vector_tile::buffer tile(buffer);
-    for (auto const& name : tile.layerNames()) {
-        const mapbox::vector_tile::layer layer = tile.getLayer(name);
+    for (auto const& fields : tile.getLayerFields()) {
+        const mapbox::vector_tile::layer layer(fields);
         std::size_t num_features = layer.featureCount();
         if (num_features == 0) {
-            std::cout << "Layer '" << name << "' (empty)\n";
+            std::cout << "Layer '" << layer.getName() << "' (empty)\n";
             continue;
         }
         for (std::size_t i=0;i<num_features;++i) {
@@ -27,6 +27,16 @@ static void decode_entire_tile(std::string const& buffer) {
     }
 }
 
+// Geometry only, decoding each layer into one reused arena
+static void decode_tile_geometries(std::string const& buffer, mapbox::vector_tile::layer_geometry_buffer& arena) {
+    mapbox::vector_tile::buffer tile(buffer);
+    for (auto const& fields : tile.getLayerFields()) {
+        const mapbox::vector_tile::layer layer(fields);
+        layer.decodeGeometries(arena);
+        feature_count += arena.featureCount();
+    }
+}
+
 static void run_bench(std::vector<std::string> const& tiles, std::size_t iterations) {
 
     for (std::size_t i=0;i<iterations;++i) {
@@ -36,6 +46,15 @@ static void run_bench(std::vector<std::string> const& tiles, std::size_t iterati
     }
 }
 
+static void run_geometry_bench(std::vector<std::string> const& tiles, std::size_t iterations) {
+    mapbox::vector_tile::layer_geometry_buffer arena;
+    for (std::size_t i=0;i<iterations;++i) {
+        for (auto const& tile: tiles) {
+            decode_tile_geometries(tile, arena);
+        }
+    }
+}
+
 template <typename T>
 using milliseconds = std::chrono::duration<T, std::milli>;
 
@@ -69,6 +88,17 @@ int main(/*int argc, char* const argv[]*/) {
             std::clog << "Warning expected feature_count of 8157770, was: " << feature_count << "\n";
         }
         std::clog << "elapsed: " << std::fixed << elapsed << " ms\n";
+        std::clog << "running layer geometry bench...\n";
+        feature_count = 0;
+        run_geometry_bench(tiles,1);
+        t1 = std::chrono::high_resolution_clock::now();
+        run_geometry_bench(tiles,100);
+        t2 = std::chrono::high_resolution_clock::now();
+        elapsed = milliseconds<double>(t2 - t1).count();
+        if (feature_count != 8157770) {
+            std::clog << "Warning expected feature_count of 8157770, was: " << feature_count << "\n";
+        }
+        std::clog << "elapsed: " << std::fixed << elapsed << " ms\n";
     } catch (std::exception const& ex) {
         std::cerr << ex.what() << "\n";
         return -1;
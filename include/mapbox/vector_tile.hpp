@@ -1,21 +1,163 @@
 #pragma once
 
 #include "vector_tile/vector_tile_config.hpp"
+#include "vector_tile/clip.hpp"
+#include "vector_tile/grid_index.hpp"
+#include "vector_tile/simplify.hpp"
+#include "vector_tile/transform.hpp"
+#include "vector_tile/varint.hpp"
 #include <mapbox/geometry.hpp>
 #include <mapbox/feature.hpp>
 #include <protozero/pbf_reader.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
-#include <map>
-#include <functional> // reference_wrapper
+#include <limits>
 #include <string>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace mapbox { namespace vector_tile {
 
+namespace detail {
+
+// 32 bit FNV-1a, good enough for the short attribute keys found in tiles
+inline std::uint32_t hash_bytes(protozero::data_view const& bytes) {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        hash ^= static_cast<std::uint8_t>(bytes.data()[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+inline std::int32_t checked_coordinate(std::int64_t value) {
+    if (value > std::numeric_limits<std::int32_t>::max() ||
+        value < std::numeric_limits<std::int32_t>::min()) {
+        throw std::runtime_error("paths outside valid range of coordinate_type");
+    }
+    return static_cast<std::int32_t>(value);
+}
+
+// Most points per decode_line_run call, sized for a stack buffer
+constexpr std::size_t line_run_points = 64;
+
+// Decode the next points of a LineTo command of `length` points in a single
+// decode_deltas run over the values the reader has buffered. Returns how many
+// points were written to `points`, or 0 if the caller should decode the next
+// point on its own (short runs, or runs that could overflow 32 bits).
+inline std::size_t decode_line_run(packed_uint32_reader& reader, std::uint32_t length,
+                                   std::int64_t& x, std::int64_t& y,
+                                   std::int32_t* points, coordinate_bounds& bounds) {
+    if (length < 2) {
+        return 0;
+    }
+    const std::size_t run = std::min({static_cast<std::size_t>(length),
+                                      reader.available() / 2,
+                                      line_run_points});
+    if (run < 2 || !decode_deltas(reader.data(), run, x, y, points, bounds)) {
+        return 0;
+    }
+    reader.advance(2 * run);
+    return run;
+}
+
+// Sinks may define `command(std::uint8_t cmd, std::uint32_t count)` to
+// learn how many points a MoveTo or LineTo brings before they arrive.
+template <typename Sink>
+auto command_hint(Sink& sink, std::uint8_t cmd, std::uint32_t count, int)
+    -> decltype(sink.command(cmd, count), void()) {
+    sink.command(cmd, count);
+}
+
+template <typename Sink>
+void command_hint(Sink&, std::uint8_t, std::uint32_t, long) {}
+
+// Command loop shared by every geometry decoder, validating the stream the
+// same way feature::getGeometries does.
+template <typename Sink>
+void decode_geometry(protozero::data_view const& geometry, Sink& sink) {
+    std::uint8_t cmd = 1;
+    std::uint32_t length = 0;
+    std::int64_t x = 0;
+    std::int64_t y = 0;
+    // Every point takes at least two bytes, which bounds the counts passed
+    // on to command_hint whatever the commands claim
+    const std::uint32_t max_points = static_cast<std::uint32_t>(
+        std::min<std::size_t>(geometry.size() / 2, std::numeric_limits<std::uint32_t>::max()));
+
+    packed_uint32_reader reader(geometry);
+    std::int32_t points[2 * line_run_points];
+    while (!reader.empty()) {
+        if (length == 0) {
+            std::uint32_t cmd_length = reader.next();
+            cmd = cmd_length & 0x7;
+            length = cmd_length >> 3;
+            if (length > 0 && (cmd == CommandType::MOVE_TO || cmd == CommandType::LINE_TO)) {
+                command_hint(sink, cmd, std::min(length, max_points), 0);
+            }
+        }
+
+        if (cmd == CommandType::MOVE_TO || cmd == CommandType::LINE_TO) {
+            if (length == 0) {
+                // Invalid command count, read the next command instead
+                continue;
+            }
+            if (cmd == CommandType::LINE_TO) {
+                coordinate_bounds bounds;
+                const std::size_t run = decode_line_run(reader, length, x, y, points, bounds);
+                if (run > 0) {
+                    for (std::size_t i = 0; i < run; ++i) {
+                        sink.line_to(points[2 * i], points[2 * i + 1]);
+                    }
+                    length -= static_cast<std::uint32_t>(run);
+                    continue;
+                }
+            }
+            --length;
+            x += protozero::decode_zigzag32(reader.next());
+            y += protozero::decode_zigzag32(reader.next());
+            if (cmd == CommandType::MOVE_TO) {
+                sink.move_to(checked_coordinate(x), checked_coordinate(y));
+            } else {
+                sink.line_to(checked_coordinate(x), checked_coordinate(y));
+            }
+        } else if (cmd == CommandType::CLOSE) {
+            sink.close();
+            length = 0;
+        } else {
+            throw std::runtime_error("unknown command");
+        }
+    }
+}
+
+} // namespace detail
+
 using point_type = mapbox::geometry::point<std::int16_t>;
 
+/**
+ * Bounding box in tile coordinates. A geometry without points has the
+ * empty box, whose min is greater than its max.
+ */
+using bbox_type = mapbox::geometry::box<std::int32_t>;
+
+/**
+ * A decoded property value that does not own its string bytes: strings are
+ * `protozero::data_view`s into the tile and stay valid only as long as the
+ * tile data does.
+ */
+using value_view = mapbox::util::variant<mapbox::feature::null_value_t,
+                                         bool,
+                                         std::uint64_t,
+                                         std::int64_t,
+                                         double,
+                                         protozero::data_view>;
+
 class points_array_type : public std::vector<point_type> {
 public:
     using coordinate_type = point_type::coordinate_type;
@@ -30,8 +172,469 @@ public:
     points_arrays_type(Args&&... args) : std::vector<points_array_type>(std::forward<Args>(args)...) {}
 };
 
+/**
+ * Flat, structure of arrays storage for decoded tile coordinates. It is a
+ * sink for feature::decodeGeometry: every MoveTo point starts a new ring
+ * and ClosePath repeats the ring's first point, matching the paths
+ * getGeometries returns. Decoding appends, so one buffer can collect many
+ * features, and clear() keeps the capacity for the next round.
+ */
+class geometry_buffer {
+public:
+    std::vector<std::int32_t> x;
+    std::vector<std::int32_t> y;
+    // Index into x/y of the first point of every ring
+    std::vector<std::uint32_t> rings;
+
+    std::size_t pointCount() const { return x.size(); }
+    std::size_t ringCount() const { return rings.size(); }
+    std::size_t ringBegin(std::size_t ring) const { return rings[ring]; }
+    std::size_t ringEnd(std::size_t ring) const {
+        return ring + 1 < rings.size() ? rings[ring + 1] : x.size();
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        rings.clear();
+    }
+
+    void move_to(std::int32_t px, std::int32_t py) {
+        rings.push_back(static_cast<std::uint32_t>(x.size()));
+        x.push_back(px);
+        y.push_back(py);
+    }
+
+    void line_to(std::int32_t px, std::int32_t py) {
+        if (rings.empty()) {
+            rings.push_back(static_cast<std::uint32_t>(x.size()));
+        }
+        x.push_back(px);
+        y.push_back(py);
+    }
+
+    void close() {
+        if (!rings.empty() && rings.back() < x.size()) {
+            x.push_back(x[rings.back()]);
+            y.push_back(y[rings.back()]);
+        }
+    }
+};
+
+/**
+ * Geometry of every feature of a layer in one arena, filled by
+ * layer::decodeGeometries. Feature i owns rings
+ * [featureRingBegin(i), featureRingEnd(i)) of `geometry`.
+ */
+class layer_geometry_buffer {
+public:
+    geometry_buffer geometry;
+    // Index into geometry.rings of the first ring of every feature
+    std::vector<std::uint32_t> features;
+    std::vector<GeomType> types;
+
+    std::size_t featureCount() const { return features.size(); }
+    std::size_t featureRingBegin(std::size_t feature) const { return features[feature]; }
+    std::size_t featureRingEnd(std::size_t feature) const {
+        return feature + 1 < features.size() ? features[feature + 1] : geometry.ringCount();
+    }
+
+    void clear() {
+        geometry.clear();
+        features.clear();
+        types.clear();
+    }
+};
+
+namespace detail {
+
+// Appends one feature to a shared geometry_buffer, making sure a malformed
+// geometry that does not start with MoveTo cannot extend or close the
+// previous feature's last ring.
+struct feature_geometry_sink {
+    geometry_buffer& out;
+    bool started = false;
+
+    void move_to(std::int32_t x, std::int32_t y) {
+        started = true;
+        out.move_to(x, y);
+    }
+
+    void line_to(std::int32_t x, std::int32_t y) {
+        if (!started) {
+            out.rings.push_back(static_cast<std::uint32_t>(out.pointCount()));
+            started = true;
+        }
+        out.line_to(x, y);
+    }
+
+    void close() {
+        if (started) {
+            out.close();
+        }
+    }
+};
+
+// Tracks the bounds of the decoded points without storing them
+struct bbox_sink {
+    coordinate_bounds bounds;
+
+    void move_to(std::int32_t x, std::int32_t y) {
+        bounds.min_x = std::min(bounds.min_x, x);
+        bounds.min_y = std::min(bounds.min_y, y);
+        bounds.max_x = std::max(bounds.max_x, x);
+        bounds.max_y = std::max(bounds.max_y, y);
+    }
+
+    void line_to(std::int32_t x, std::int32_t y) {
+        move_to(x, y);
+    }
+
+    // ClosePath repeats a point already seen
+    void close() {}
+
+    bbox_type box() const {
+        return bbox_type({bounds.min_x, bounds.min_y}, {bounds.max_x, bounds.max_y});
+    }
+};
+
+// Maps tile coordinates to output points through a transform policy,
+// range checking them unless the caller proved they fit.
+template <typename CoordinateType, typename Transform>
+class point_mapper {
+public:
+    point_mapper(Transform const& transform, bool check_range)
+        : transform_(transform),
+          check_range_(check_range) {}
+
+    mapbox::geometry::point<CoordinateType> operator()(std::int32_t x, std::int32_t y) const {
+        const auto px = transform_.x(x);
+        const auto py = transform_.y(y);
+        if (check_range_ &&
+            (!coordinate_in_range<CoordinateType>(px) ||
+             !coordinate_in_range<CoordinateType>(py))) {
+            throw std::runtime_error("paths outside valid range of coordinate_type");
+        }
+        return mapbox::geometry::point<CoordinateType>(static_cast<CoordinateType>(px), static_cast<CoordinateType>(py));
+    }
+
+private:
+    Transform const& transform_;
+    bool check_range_;
+};
+
+// Collects paths the way getGeometries lays them out: every MoveTo point
+// starts a path and ClosePath repeats the path's first point
+template <typename GeometryCollectionType, typename Transform>
+struct paths_sink {
+    GeometryCollectionType& out;
+    point_mapper<typename GeometryCollectionType::coordinate_type, Transform> const& map;
+
+    void move_to(std::int32_t x, std::int32_t y) {
+        out.emplace_back();
+        add(x, y);
+    }
+
+    void line_to(std::int32_t x, std::int32_t y) {
+        if (out.empty()) {
+            out.emplace_back();
+        }
+        add(x, y);
+    }
+
+    void close() {
+        if (!out.empty() && !out.back().empty()) {
+            out.back().push_back(out.back()[0]);
+        }
+    }
+
+    void add(std::int32_t x, std::int32_t y) {
+        const auto p = map(x, y);
+        out.back().emplace_back(p.x, p.y);
+    }
+};
+
+// Collects every point of a POINT feature
+template <typename CoordinateType, typename Transform>
+struct multi_point_sink {
+    mapbox::geometry::multi_point<CoordinateType>& out;
+    point_mapper<CoordinateType, Transform> const& map;
+
+    void command(std::uint8_t cmd, std::uint32_t count) {
+        if (cmd == CommandType::MOVE_TO) {
+            out.reserve(out.size() + count);
+        }
+    }
+
+    void move_to(std::int32_t x, std::int32_t y) { out.push_back(map(x, y)); }
+    void line_to(std::int32_t x, std::int32_t y) { out.push_back(map(x, y)); }
+    void close() {}
+};
+
+// Collects the lines of a LINESTRING feature, dropping lines of less than
+// two points. Call finish() once decoding is done.
+template <typename CoordinateType, typename Transform>
+struct multi_line_string_sink {
+    mapbox::geometry::multi_line_string<CoordinateType>& out;
+    point_mapper<CoordinateType, Transform> const& map;
+
+    void command(std::uint8_t cmd, std::uint32_t count) {
+        if (cmd == CommandType::LINE_TO && !out.empty()) {
+            out.back().reserve(out.back().size() + count);
+        }
+    }
+
+    void move_to(std::int32_t x, std::int32_t y) {
+        finish();
+        out.emplace_back();
+        out.back().push_back(map(x, y));
+    }
+
+    void line_to(std::int32_t x, std::int32_t y) {
+        if (out.empty()) {
+            out.emplace_back();
+        }
+        out.back().push_back(map(x, y));
+    }
+
+    void close() {}
+
+    void finish() {
+        if (!out.empty() && out.back().size() < 2) {
+            out.pop_back();
+        }
+    }
+};
+
+/**
+ * Assembles polygon rings into a multi_polygon as they are decoded. Each
+ * ring's signed area is summed point by point in tile coordinates, so that
+ * when the ring ends it is known to be an exterior ring, starting a new
+ * polygon, or a hole of the current one. Like mapbox-gl, rings winding the
+ * same way as the first ring are exterior rings. Rings with fewer than
+ * three points or no area are dropped, as are holes before any exterior
+ * ring.
+ */
+template <typename CoordinateType, typename Transform>
+class multi_polygon_sink {
+public:
+    multi_polygon_sink(mapbox::geometry::multi_polygon<CoordinateType>& out,
+                       point_mapper<CoordinateType, Transform> const& map)
+        : out_(out),
+          map_(map) {}
+
+    void command(std::uint8_t cmd, std::uint32_t count) {
+        if (cmd == CommandType::LINE_TO) {
+            // The LineTo points and the closing point
+            ring_.reserve(ring_.size() + count + 1);
+        }
+    }
+
+    void move_to(std::int32_t x, std::int32_t y) {
+        finish();
+        first_x_ = x;
+        first_y_ = y;
+        add(x, y);
+    }
+
+    void line_to(std::int32_t x, std::int32_t y) {
+        if (ring_.empty()) {
+            move_to(x, y);
+            return;
+        }
+        // Shoelace term relative to the first point, keeping the products small
+        area_ += static_cast<double>(prev_x_ - first_x_) * static_cast<double>(y - first_y_) -
+                 static_cast<double>(x - first_x_) * static_cast<double>(prev_y_ - first_y_);
+        add(x, y);
+    }
+
+    void close() {
+        finish();
+    }
+
+    // Close and classify the ring being decoded, if any
+    void finish() {
+        if (ring_.empty()) {
+            return;
+        }
+        if (prev_x_ != first_x_ || prev_y_ != first_y_) {
+            ring_.push_back(ring_.front());
+        }
+        // Rings hold their closing point on top of three or more others
+        if (ring_.size() >= 4 && area_ > 0.0) {
+            add_ring(true);
+        } else if (ring_.size() >= 4 && area_ < 0.0) {
+            add_ring(false);
+        }
+        ring_.clear();
+        area_ = 0.0;
+    }
+
+private:
+    void add(std::int32_t x, std::int32_t y) {
+        ring_.push_back(map_(x, y));
+        prev_x_ = x;
+        prev_y_ = y;
+    }
+
+    void add_ring(bool positive) {
+        if (exterior_sign_ == 0) {
+            exterior_sign_ = positive ? 1 : -1;
+        }
+        if ((exterior_sign_ > 0) == positive) {
+            out_.emplace_back();
+        } else if (out_.empty()) {
+            return;
+        }
+        out_.back().push_back(std::move(ring_));
+        ring_ = mapbox::geometry::linear_ring<CoordinateType>();
+    }
+
+    mapbox::geometry::multi_polygon<CoordinateType>& out_;
+    point_mapper<CoordinateType, Transform> const& map_;
+    mapbox::geometry::linear_ring<CoordinateType> ring_;
+    double area_ = 0.0;
+    int exterior_sign_ = 0;
+    std::int64_t first_x_ = 0;
+    std::int64_t first_y_ = 0;
+    std::int64_t prev_x_ = 0;
+    std::int64_t prev_y_ = 0;
+};
+
+// Whether (x, y) lies within `tolerance` of a decoded geometry: near one of
+// its points or segments, or inside a polygon. Polygon rings are combined
+// with the even-odd rule, which handles holes and multipolygons alike, and
+// are closed implicitly.
+inline bool hit_test(geometry_buffer const& geometry, GeomType type,
+                     std::int32_t x, std::int32_t y, double tolerance) {
+    const double px = x;
+    const double py = y;
+    const double tolerance_squared = tolerance * tolerance;
+    bool inside = false;
+    for (std::size_t ring = 0; ring < geometry.ringCount(); ++ring) {
+        const std::size_t begin = geometry.ringBegin(ring);
+        const std::size_t end = geometry.ringEnd(ring);
+        if (end - begin == 1 || type == GeomType::POINT) {
+            for (std::size_t i = begin; i < end; ++i) {
+                if (segment_distance_squared(px, py, geometry.x[i], geometry.y[i], geometry.x[i], geometry.y[i]) <= tolerance_squared) {
+                    return true;
+                }
+            }
+            continue;
+        }
+        const bool closed = type == GeomType::POLYGON;
+        for (std::size_t i = begin; i < end; ++i) {
+            std::size_t j = i + 1;
+            if (j == end) {
+                if (!closed) {
+                    break;
+                }
+                j = begin;
+            }
+            const double ax = geometry.x[i];
+            const double ay = geometry.y[i];
+            const double bx = geometry.x[j];
+            const double by = geometry.y[j];
+            if (segment_distance_squared(px, py, ax, ay, bx, by) <= tolerance_squared) {
+                return true;
+            }
+            if (closed && (ay > py) != (by > py)) {
+                // Crossing to the right of the point
+                const double cross = (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+                if (by > ay ? cross > 0.0 : cross < 0.0) {
+                    inside = !inside;
+                }
+            }
+        }
+    }
+    return inside;
+}
+
+// Type and geometry of an encoded feature, without decoding anything else
+inline protozero::data_view feature_geometry(protozero::data_view const& feature_view, GeomType& type) {
+    protozero::data_view geometry;
+    type = GeomType::UNKNOWN;
+    protozero::pbf_reader feature_pbf(feature_view);
+    while (feature_pbf.next()) {
+        switch (feature_pbf.tag()) {
+        case FeatureType::TYPE:
+            type = static_cast<GeomType>(feature_pbf.get_enum());
+            break;
+        case FeatureType::GEOMETRY:
+            geometry = feature_pbf.get_view();
+            break;
+        default:
+            feature_pbf.skip();
+            break;
+        }
+    }
+    return geometry;
+}
+
+} // namespace detail
+
 class layer;
 
+/**
+ * A key resolved once against a layer's key table with layer::resolveKey,
+ * so that feature::getValue only compares key indices for every feature of
+ * that layer.
+ */
+class key_handle {
+public:
+    bool empty() const { return count == 0; }
+
+private:
+    friend class layer;
+    friend class feature;
+
+    bool matches(std::uint32_t index) const {
+        return index == first ||
+               (!duplicates.empty() && std::binary_search(duplicates.begin(), duplicates.end(), index));
+    }
+
+    std::uint32_t first = detail::no_slot;
+    std::uint32_t count = 0;
+    // Further indices of the key in ascending order, only filled when the
+    // layer repeats it
+    std::vector<std::uint32_t> duplicates;
+};
+
+/**
+ * Keys resolved once against a layer's key table with layer::resolveKeys,
+ * to read several values per feature of that layer with feature::getValues.
+ */
+class key_set {
+public:
+    std::size_t size() const { return aliases.size(); }
+
+private:
+    friend class layer;
+    friend class feature;
+
+    // Requested slot for each key index of the layer, no_slot if not requested
+    std::vector<std::uint32_t> slots;
+    // For each requested slot, the earlier slot asking for the same key or no_slot
+    std::vector<std::uint32_t> aliases;
+    // Number of slots that can be filled by a tag
+    std::size_t resolved = 0;
+};
+
+/**
+ * Scratch space for layer::queryPoint and layer::queryPoints. Passing the
+ * same buffer to every call, e.g. on every pointer move, reuses its
+ * allocations. A buffer must not be shared by concurrent queries.
+ */
+class query_buffer {
+private:
+    friend class layer;
+
+    std::vector<std::size_t> candidates;
+    // (feature, point) pairs of queryPoints
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    geometry_buffer geometry;
+};
+
 class feature {
 public:
     using properties_type = mapbox::feature::property_map;
@@ -57,62 +660,286 @@ public:
      *       and cleaned up after use.
      */
     mapbox::feature::value getValue(std::string const&, std::string* warning = nullptr) const;
+    /**
+     * Same lookup as getValue, but returns the layer's decoded value without
+     * copying strings out of the tile. Use toValue() to get an owning value.
+     */
+    value_view getValueView(std::string const&, std::string* warning = nullptr) const;
+    /**
+     * getValue and getValueView for a key resolved with layer::resolveKey on
+     * this feature's layer.
+     */
+    mapbox::feature::value getValue(key_handle const&, std::string* warning = nullptr) const;
+    value_view getValueView(key_handle const&, std::string* warning = nullptr) const;
+    /**
+     * Read the values of all keys in `keys`, which must come from this
+     * feature's layer, in a single pass over the tags. `values` is resized
+     * to `keys.size()` and slot i receives the value of the i-th key, or
+     * null if the feature does not have it. Reuse `values` across features
+     * to avoid allocating.
+     */
+    void getValues(key_set const& keys, std::vector<value_view>& values) const;
     properties_type getProperties() const;
+    /**
+     * Call `visitor(key, value)` for every tag of the feature in tag order,
+     * where `key` is a `protozero::data_view` and `value` a `value_view const&`,
+     * both backed by the tile. Unlike getProperties this never allocates.
+     */
+    template <typename Visitor>
+    void forEachProperty(Visitor&& visitor) const;
     mapbox::feature::identifier const& getID() const;
     std::uint32_t getExtent() const;
     std::uint32_t getVersion() const;
     template <typename GeometryCollectionType>
     GeometryCollectionType getGeometries(float scale) const;
+    /**
+     * getGeometries mapping coordinates through a transform policy from
+     * vector_tile/transform.hpp, such as identity_transform, which needs no
+     * floating point at all. getGeometries(scale) uses identity_transform
+     * or shift_transform for powers of two and scale_transform otherwise.
+     */
+    template <typename GeometryCollectionType, typename Transform,
+              typename = typename std::enable_if<!std::is_arithmetic<Transform>::value>::type>
+    GeometryCollectionType getGeometries(Transform const& transform) const;
+    /**
+     * Stream the geometry to `sink` without building any container. The
+     * sink is called with tile coordinates as the commands are decoded:
+     *
+     *     sink.move_to(std::int32_t x, std::int32_t y); // each point of a MoveTo
+     *     sink.line_to(std::int32_t x, std::int32_t y); // each point of a LineTo
+     *     sink.close();                                 // each ClosePath
+     *
+     * For POINT features every point arrives as a move_to.
+     */
+    template <typename Sink>
+    void decodeGeometry(Sink&& sink) const;
+    /**
+     * Bounding box of the geometry in tile coordinates, computed while
+     * decoding without storing any points.
+     */
+    bbox_type getBBox() const;
+    /**
+     * Decode a POLYGON feature straight into a multi_polygon, splitting
+     * exterior rings from holes by their signed area while decoding and
+     * dropping degenerate rings. Coordinates go through `transform` as in
+     * getGeometries. Features of other types give an empty multi_polygon.
+     */
+    template <typename CoordinateType, typename Transform = identity_transform>
+    mapbox::geometry::multi_polygon<CoordinateType> getMultiPolygon(Transform const& transform = Transform()) const;
+    /**
+     * Decode into the matching mapbox::geometry alternative: point or
+     * multi_point, line_string or multi_line_string, polygon or
+     * multi_polygon depending on the type and how many parts are left,
+     * and empty when there is nothing to decode. Lines of less than two
+     * points and degenerate rings are dropped. Coordinates go through
+     * `transform` as in getGeometries.
+     */
+    template <typename CoordinateType, typename Transform = identity_transform>
+    mapbox::geometry::geometry<CoordinateType> getGeometry(Transform const& transform = Transform()) const;
+    /**
+     * decodeGeometry keeping only the part of the geometry inside `clip`,
+     * in tile coordinates with edges included. Points outside are dropped,
+     * lines are cut where they leave the rectangle and polygon rings are
+     * clipped to it, all while decoding. Points where the geometry crosses
+     * the rectangle are rounded to tile coordinates. UNKNOWN features
+     * produce nothing.
+     */
+    template <typename Sink>
+    void decodeClippedGeometry(bbox_type const& clip, Sink&& sink) const;
+    /**
+     * getGeometry for the part of the geometry inside `clip`, see
+     * decodeClippedGeometry. The transform applies after clipping.
+     */
+    template <typename CoordinateType, typename Transform = identity_transform>
+    mapbox::geometry::geometry<CoordinateType> getClippedGeometry(bbox_type const& clip,
+                                                                  Transform const& transform = Transform()) const;
+    /**
+     * decodeGeometry simplifying lines and polygon rings with Douglas-Peucker
+     * to within `tolerance` tile units and dropping repeated points, as the
+     * geometry is decoded. Rings stay closed and keep at least three
+     * distinct points. Points of POINT features are passed on as they are.
+     */
+    template <typename Sink>
+    void decodeSimplifiedGeometry(double tolerance, Sink&& sink) const;
+    /**
+     * getGeometries with the simplification of decodeSimplifiedGeometry,
+     * `tolerance` being in tile units before scaling.
+     */
+    template <typename GeometryCollectionType>
+    GeometryCollectionType getSimplifiedGeometries(double tolerance, float scale) const;
 
 private:
+    template <typename Result, typename Build>
+    Result withScaleTransform(float scale, Build const& build) const;
+    template <typename GeometryCollectionType, GeomType Type, bool CheckRange, typename Transform>
+    GeometryCollectionType buildGeometries(Transform const& transform) const;
+    template <typename GeometryCollectionType, typename Transform>
+    GeometryCollectionType buildSimplifiedGeometries(double tolerance, Transform const& transform) const;
+    template <typename CoordinateType, typename Transform, typename Decode>
+    mapbox::geometry::geometry<CoordinateType> buildGeometry(Transform const& transform, Decode const& decode) const;
+
     const layer& layer_;
     mapbox::feature::identifier id;
     GeomType type = GeomType::UNKNOWN;
-    packed_iterator_type tags_iter;
-    packed_iterator_type geometry_iter;
+    // Packed TAGS and GEOMETRY fields, decoded with detail::packed_uint32_reader
+    protozero::data_view tags;
+    protozero::data_view geometry;
+};
+
+/**
+ * The fields of one layer, read in a single pass over it: views into the
+ * tile bytes for the name, keys, values and features. buffer records them
+ * for every layer when it opens a tile, and getLayer builds the layer from
+ * them without reading it again. As in protobuf, the last NAME, EXTENT and
+ * VERSION fields win.
+ */
+struct layer_fields {
+    explicit layer_fields(protozero::data_view const& layer_view);
+
+    /// Throw "missing required field: ..." unless VERSION, EXTENT and NAME were all read.
+    void checkRequired() const;
+
+    protozero::data_view name;
+    std::uint32_t version = 1;
+    std::uint32_t extent = 4096;
+    bool has_name = false;
+    bool has_version = false;
+    bool has_extent = false;
+    std::vector<protozero::data_view> keys;
+    std::vector<protozero::data_view> values;
+    std::vector<protozero::data_view> features;
 };
 
 class layer {
 public:
     layer(protozero::data_view const& layer_view);
+    explicit layer(layer_fields fields);
 
     std::size_t featureCount() const { return features.size(); }
     protozero::data_view const& getFeature(std::size_t) const;
     std::string const& getName() const;
     std::uint32_t getExtent() const { return extent; }
     std::uint32_t getVersion() const { return version; }
+    /**
+     * Decode the geometry of every feature into `out`, which is cleared
+     * first but keeps its capacity, without constructing `feature`s.
+     */
+    void decodeGeometries(layer_geometry_buffer& out) const;
+    /**
+     * Bounding box of every feature, in feature order, without constructing
+     * `feature`s. `out` is cleared first but keeps its capacity.
+     */
+    void getBBoxes(std::vector<bbox_type>& out) const;
+    /**
+     * Build a grid over the feature bounding boxes for queryBBox, queryPoint
+     * and queryPoints to use. Without it every query reads the bounding box
+     * of every feature. Queries never modify the layer, so an indexed layer
+     * can be queried from several threads.
+     */
+    void buildIndex();
+    bool isIndexed() const { return indexed; }
+    /**
+     * Indices of the features whose bounding box intersects `box`, in
+     * ascending order. `out` is cleared first but keeps its capacity.
+     */
+    void queryBBox(bbox_type const& box, std::vector<std::size_t>& out) const;
+    /**
+     * Indices of the features under (x, y), in ascending order: points and
+     * lines within `tolerance` tile units of it and polygons containing it
+     * or within `tolerance` of their outline. Only features whose bounding
+     * box is within reach are decoded. Like queryBBox, `out` is cleared
+     * first but keeps its capacity; `scratch` keeps the working storage
+     * across calls.
+     */
+    void queryPoint(std::int32_t x, std::int32_t y, double tolerance, std::vector<std::size_t>& out,
+                    query_buffer& scratch) const;
+    void queryPoint(std::int32_t x, std::int32_t y, double tolerance, std::vector<std::size_t>& out) const;
+    /**
+     * queryPoint for many points at once, decoding each candidate feature
+     * only once. `out[i]` receives the features under `points[i]`.
+     */
+    void queryPoints(std::vector<mapbox::geometry::point<std::int32_t>> const& points, double tolerance,
+                     std::vector<std::vector<std::size_t>>& out, query_buffer& scratch) const;
+    void queryPoints(std::vector<mapbox::geometry::point<std::int32_t>> const& points, double tolerance,
+                     std::vector<std::vector<std::size_t>>& out) const;
+    key_handle resolveKey(std::string const& key) const;
+    key_set resolveKeys(std::vector<std::string> const& names) const;
 
 private:
     friend class feature;
 
+    void buildKeysTable();
+    template <typename F>
+    void forEachKeyIndex(protozero::data_view const& key, F&& f) const;
+    value_view const& getValueView(std::size_t index) const;
+    void appendCandidates(bbox_type const& box, std::vector<std::size_t>& out) const;
+    bbox_type reach(std::int32_t x, std::int32_t y, double tolerance) const;
+
     std::string name;
     std::uint32_t version;
     std::uint32_t extent;
-    std::multimap<std::string, std::uint32_t> keysMap;
-    std::vector<std::reference_wrapper<const std::string>> keys;
+    // Keys in tile order, viewing the tile bytes
+    std::vector<protozero::data_view> keys;
+    // Open addressing table over the distinct `keys`: each slot holds the
+    // index + 1 of the first occurrence of a key, 0 marks an empty slot.
+    std::vector<std::uint32_t> keysTable;
+    // Next index of the same key for every key index, no_slot at the last
+    // one, so duplicates never lengthen a probe sequence
+    std::vector<std::uint32_t> nextDuplicate;
     std::vector<protozero::data_view> values;
+    // `values` decoded once by the constructor, shared by every feature
+    std::vector<value_view> decodedValues;
+    // Ascending indices of the values that failed to decode, which throw
+    // when a feature reads them
+    std::vector<std::uint32_t> malformedValues;
+    // Spatial index over feature bounding boxes, built by buildIndex()
+    std::vector<bbox_type> featureBoxes;
+    detail::grid_index featureIndex;
+    bool indexed;
     std::vector<protozero::data_view> features;
 };
 
 class buffer {
 public:
+    /**
+     * The buffer does not copy the tile: layers are indexed as views into
+     * `data`, which must outlive the buffer and any layer obtained from it.
+     */
     buffer(std::string const& data);
+    buffer(protozero::data_view const& data);
+    buffer(const char* data, std::size_t size);
+
+    /**
+     * Layers in the order they appear in the tile, as (name, layer) views
+     * into the tile bytes. Only the first layer of a given name is kept.
+     */
+    using layers_type = std::vector<std::pair<protozero::data_view, protozero::data_view>>;
+
+    std::size_t layerCount() const { return layers.size(); }
     std::vector<std::string> layerNames() const;
-    std::map<std::string, const protozero::data_view> getLayers() const { return layers; };
+    layers_type const& getLayers() const { return layers; }
+    /**
+     * The fields of every layer of getLayers(), in the same order, as read
+     * while opening the tile.
+     */
+    std::vector<layer_fields> const& getLayerFields() const { return fields; }
     layer getLayer(const std::string&) const;
 
 private:
-    std::map<std::string, const protozero::data_view> layers;
+    layers_type::const_iterator findLayer(protozero::data_view const& name) const;
+
+    layers_type layers;
+    std::vector<layer_fields> fields;
 };
 
-static mapbox::feature::value parseValue(protozero::data_view const& value_view) {
-    mapbox::feature::value value;
-    protozero::pbf_reader value_reader(value_view);
+inline value_view parseValueView(protozero::data_view const& data) {
+    value_view value;
+    protozero::pbf_reader value_reader(data);
     while (value_reader.next())
     {
         switch (value_reader.tag()) {
         case ValueType::STRING:
-            value = value_reader.get_string();
+            value = value_reader.get_view();
             break;
         case ValueType::FLOAT:
             value = static_cast<double>(value_reader.get_float());
@@ -140,12 +967,35 @@ static mapbox::feature::value parseValue(protozero::data_view const& value_view)
     return value;
 }
 
+/**
+ * Convert a value_view into an owning `mapbox::feature::value`, copying
+ * string bytes out of the tile.
+ */
+inline mapbox::feature::value toValue(value_view const& view) {
+    if (view.is<protozero::data_view>()) {
+        return view.get<protozero::data_view>().to_string();
+    } else if (view.is<bool>()) {
+        return view.get<bool>();
+    } else if (view.is<std::uint64_t>()) {
+        return view.get<std::uint64_t>();
+    } else if (view.is<std::int64_t>()) {
+        return view.get<std::int64_t>();
+    } else if (view.is<double>()) {
+        return view.get<double>();
+    }
+    return mapbox::feature::null_value;
+}
+
+inline mapbox::feature::value parseValue(protozero::data_view const& data) {
+    return toValue(parseValueView(data));
+}
+
 inline feature::feature(protozero::data_view const& feature_view, layer const& l)
     : layer_(l),
       id(),
       type(GeomType::UNKNOWN),
-      tags_iter(),
-      geometry_iter()
+      tags(),
+      geometry()
     {
     protozero::pbf_reader feature_pbf(feature_view);
     while (feature_pbf.next()) {
@@ -154,13 +1004,13 @@ inline feature::feature(protozero::data_view const& feature_view, layer const& l
             id = feature_pbf.get_uint64();
             break;
         case FeatureType::TAGS:
-            tags_iter = feature_pbf.get_packed_uint32();
+            tags = feature_pbf.get_view();
             break;
         case FeatureType::TYPE:
             type = static_cast<GeomType>(feature_pbf.get_enum());
             break;
         case FeatureType::GEOMETRY:
-            geometry_iter = feature_pbf.get_packed_uint32();
+            geometry = feature_pbf.get_view();
             break;
         default:
             feature_pbf.skip();
@@ -170,62 +1020,121 @@ inline feature::feature(protozero::data_view const& feature_view, layer const& l
 }
 
 inline mapbox::feature::value feature::getValue(const std::string& key, std::string* warning ) const {
-    const auto key_range = layer_.keysMap.equal_range(key);
-    const auto key_count = std::distance(key_range.first, key_range.second) ;
-    if (key_count < 1) {
+    return toValue(getValueView(key, warning));
+}
+
+inline value_view feature::getValueView(const std::string& key, std::string* warning ) const {
+    return getValueView(layer_.resolveKey(key), warning);
+}
+
+inline mapbox::feature::value feature::getValue(key_handle const& key, std::string* warning ) const {
+    return toValue(getValueView(key, warning));
+}
+
+inline value_view feature::getValueView(key_handle const& key, std::string* warning ) const {
+    if (key.empty()) {
         return mapbox::feature::null_value;
     }
 
     const auto values_count = layer_.values.size();
-    auto start_itr = tags_iter.begin();
-    const auto end_itr = tags_iter.end();
-    while (start_itr != end_itr) {
-        std::uint32_t tag_key = static_cast<std::uint32_t>(*start_itr++);
+    detail::packed_uint32_reader tags_reader(tags);
+    while (!tags_reader.empty()) {
+        std::uint32_t tag_key = tags_reader.next();
 
-        if (start_itr == end_itr) {
+        if (tags_reader.empty()) {
             throw std::runtime_error("uneven number of feature tag ids");
         }
 
-        std::uint32_t tag_val = static_cast<std::uint32_t>(*start_itr++);;
+        std::uint32_t tag_val = tags_reader.next();
         if (values_count <= tag_val) {
             throw std::runtime_error("feature referenced out of range value");
         }
 
-        bool key_found = false;
-        for (auto i = key_range.first; i != key_range.second; ++i) {
-            if (i->second == tag_key) {
-                key_found = true;
-                break;
-            }
-        }
-
-        if (key_found) {
+        if (key.matches(tag_key)) {
             // Continue process with case when same keys having multiple tag ids.
-            if (key_count > 1 && warning) {
+            if (key.count > 1 && warning) {
                 *warning = std::string("duplicate keys with different tag ids are found");
             }
-            return parseValue(layer_.values[tag_val]);
+            return layer_.getValueView(tag_val);
         }
     }
 
     return mapbox::feature::null_value;
 }
 
+template <typename Visitor>
+void feature::forEachProperty(Visitor&& visitor) const {
+    detail::packed_uint32_reader tags_reader(tags);
+    while (!tags_reader.empty()) {
+        std::uint32_t tag_key = tags_reader.next();
+        if (tags_reader.empty()) {
+            throw std::runtime_error("uneven number of feature tag ids");
+        }
+        std::uint32_t tag_val = tags_reader.next();
+        visitor(layer_.keys.at(tag_key), layer_.getValueView(tag_val));
+    }
+}
+
+inline void feature::getValues(key_set const& keys, std::vector<value_view>& values) const {
+    values.assign(keys.size(), mapbox::feature::null_value);
+    const auto values_count = layer_.values.size();
+    std::size_t found = 0;
+    // Slots filled so far, as a null value may be a tag's actual value. A
+    // word of bits covers the usual handful of keys without allocating.
+    constexpr std::size_t filled_bits_size = 64;
+    std::uint64_t filled_bits = 0;
+    std::vector<bool> filled_slots;
+    if (keys.size() > filled_bits_size) {
+        filled_slots.assign(keys.size(), false);
+    }
+    detail::packed_uint32_reader tags_reader(tags);
+    while (!tags_reader.empty() && found < keys.resolved) {
+        std::uint32_t tag_key = tags_reader.next();
+        if (tags_reader.empty()) {
+            throw std::runtime_error("uneven number of feature tag ids");
+        }
+        std::uint32_t tag_val = tags_reader.next();
+        if (values_count <= tag_val) {
+            throw std::runtime_error("feature referenced out of range value");
+        }
+        if (tag_key >= keys.slots.size()) {
+            continue;
+        }
+        const std::uint32_t slot = keys.slots[tag_key];
+        if (slot == detail::no_slot) {
+            continue;
+        }
+        // The first tag for a key wins, as in getValue
+        if (filled_slots.empty()) {
+            const std::uint64_t bit = std::uint64_t(1) << slot;
+            if (filled_bits & bit) {
+                continue;
+            }
+            filled_bits |= bit;
+        } else {
+            if (filled_slots[slot]) {
+                continue;
+            }
+            filled_slots[slot] = true;
+        }
+        values[slot] = layer_.getValueView(tag_val);
+        ++found;
+    }
+    for (std::size_t i = 0; i < keys.aliases.size(); ++i) {
+        if (keys.aliases[i] != detail::no_slot) {
+            values[i] = values[keys.aliases[i]];
+        }
+    }
+}
+
 inline feature::properties_type feature::getProperties() const {
-    auto start_itr = tags_iter.begin();
-    const auto end_itr = tags_iter.end();
     properties_type properties;
-    auto iter_len = std::distance(start_itr,end_itr);
+    auto const iter_len = detail::count_varints(tags);
     if (iter_len > 0) {
-        properties.reserve(static_cast<std::size_t>(iter_len/2));
-        while (start_itr != end_itr) {
-            std::uint32_t tag_key = static_cast<std::uint32_t>(*start_itr++);
-            if (start_itr == end_itr) {
-                throw std::runtime_error("uneven number of feature tag ids");
-            }
-            std::uint32_t tag_val = static_cast<std::uint32_t>(*start_itr++);
-            properties.emplace(layer_.keys.at(tag_key),parseValue(layer_.values.at(tag_val)));
-        }
+        properties.reserve(iter_len/2);
+        forEachProperty([&properties](protozero::data_view const& key, value_view const& value) {
+            properties.emplace(key.to_string(), toValue(value));
+        });
     }
     return properties;
 }
@@ -242,8 +1151,68 @@ inline std::uint32_t feature::getVersion() const {
     return layer_.getVersion();
 }
 
+// Calls `build` with the transform for a float scale. Scaling by a power
+// of two needs no rounding beyond what shifting does, so only other scales
+// pay for roundf on every coordinate.
+template <typename Result, typename Build>
+Result feature::withScaleTransform(float scale, Build const& build) const {
+    int shift = 0;
+    if (detail::power_of_two_shift(scale, shift)) {
+        if (shift == 0) {
+            return build(identity_transform());
+        }
+        // Every point takes at least two bytes and moves at most 2^31, so
+        // shifting left cannot overflow 64 bits for geometries this small
+        if (shift < 0 || geometry.size() / 2 < (std::size_t(1) << (32 - shift))) {
+            return build(shift_transform(shift));
+        }
+    }
+    return build(scale_transform(scale));
+}
+
 template <typename GeometryCollectionType>
 GeometryCollectionType feature::getGeometries(float scale) const {
+    return withScaleTransform<GeometryCollectionType>(scale, [this](auto const& transform) {
+        return this->template getGeometries<GeometryCollectionType>(transform);
+    });
+}
+
+template <typename GeometryCollectionType, typename Transform, typename>
+GeometryCollectionType feature::getGeometries(Transform const& transform) const {
+    // Points are only range checked when the transform can take some int32
+    // coordinate out of coordinate_type, which is known without reading
+    // the geometry.
+    const bool check_range = !detail::transform_in_range<typename GeometryCollectionType::coordinate_type>(transform);
+    // The decode loop is instantiated once per geometry type, so its type
+    // checks are compile time constants, and picked once per feature.
+    switch (type) {
+    case GeomType::POINT:
+        return check_range ? buildGeometries<GeometryCollectionType, GeomType::POINT, true>(transform)
+                           : buildGeometries<GeometryCollectionType, GeomType::POINT, false>(transform);
+    case GeomType::LINESTRING:
+        return check_range ? buildGeometries<GeometryCollectionType, GeomType::LINESTRING, true>(transform)
+                           : buildGeometries<GeometryCollectionType, GeomType::LINESTRING, false>(transform);
+    case GeomType::POLYGON:
+        return check_range ? buildGeometries<GeometryCollectionType, GeomType::POLYGON, true>(transform)
+                           : buildGeometries<GeometryCollectionType, GeomType::POLYGON, false>(transform);
+    default:
+        return check_range ? buildGeometries<GeometryCollectionType, GeomType::UNKNOWN, true>(transform)
+                           : buildGeometries<GeometryCollectionType, GeomType::UNKNOWN, false>(transform);
+    }
+}
+
+template <typename GeometryCollectionType, GeomType Type, bool CheckRange, typename Transform>
+GeometryCollectionType feature::buildGeometries(Transform const& transform) const {
+    using coordinate_type = typename GeometryCollectionType::coordinate_type;
+    // Points are collected into a single path per MoveTo. Lines and polygons
+    // reserve the MoveTo point on top of their LineTo count, polygons also
+    // the point repeated by ClosePath.
+    constexpr bool is_point = Type == GeomType::POINT;
+    constexpr std::size_t extra_coords = Type == GeomType::POLYGON ? 2 : (Type == GeomType::LINESTRING ? 1 : 0);
+    // Every point takes at least two bytes, so no valid command count
+    // exceeds this, whatever it claims.
+    const std::uint32_t max_points = static_cast<std::uint32_t>(
+        std::min<std::size_t>(geometry.size() / 2, std::numeric_limits<std::uint32_t>::max()));
     std::uint8_t cmd = 1;
     std::uint32_t length = 0;
     std::int64_t x = 0;
@@ -253,21 +1222,14 @@ GeometryCollectionType feature::getGeometries(float scale) const {
 
     paths.emplace_back();
 
-    auto start_itr = geometry_iter.begin();
-    const auto end_itr = geometry_iter.end();
+    detail::packed_uint32_reader reader(geometry);
+    std::int32_t points[2 * detail::line_run_points];
     bool first = true;
     std::uint32_t len_reserve = 0;
-    std::size_t extra_coords = 0;
-    if (type == GeomType::LINESTRING) {
-        extra_coords = 1;
-    } else if (type == GeomType::POLYGON) {
-        extra_coords = 2;
-    }
-    bool is_point = type == GeomType::POINT;
 
-    while (start_itr != end_itr) {
+    while (!reader.empty()) {
         if (length == 0) {
-            std::uint32_t cmd_length = static_cast<std::uint32_t>(*start_itr++);
+            std::uint32_t cmd_length = reader.next();
             cmd = cmd_length & 0x7;
             length = len_reserve = cmd_length >> 3;
             // Prevents the creation of vector tiles that would cause
@@ -279,6 +1241,9 @@ GeometryCollectionType feature::getGeometries(float scale) const {
             if (len_reserve > MAX_LENGTH) {
                 len_reserve = MAX_LENGTH;
             }
+            if (len_reserve > max_points) {
+                len_reserve = max_points;
+            }
         }
 
         if (cmd == CommandType::MOVE_TO || cmd == CommandType::LINE_TO) {
@@ -305,6 +1270,30 @@ GeometryCollectionType feature::getGeometries(float scale) const {
                 }
             }
 
+            if (!is_point && cmd == CommandType::LINE_TO) {
+                // Decode a run of points at once. Transforms are monotonic,
+                // so checking the transformed bounds of the run covers every
+                // point in it.
+                detail::coordinate_bounds bounds;
+                const std::size_t run = detail::decode_line_run(reader, length + 1, x, y, points, bounds);
+                if (run > 0) {
+                    if (CheckRange &&
+                        (!detail::coordinate_in_range<coordinate_type>(transform.x(bounds.min_x)) ||
+                         !detail::coordinate_in_range<coordinate_type>(transform.x(bounds.max_x)) ||
+                         !detail::coordinate_in_range<coordinate_type>(transform.y(bounds.min_y)) ||
+                         !detail::coordinate_in_range<coordinate_type>(transform.y(bounds.max_y)))) {
+                        throw std::runtime_error("paths outside valid range of coordinate_type");
+                    }
+                    for (std::size_t i = 0; i < run; ++i) {
+                        paths.back().emplace_back(
+                            static_cast<coordinate_type>(transform.x(points[2 * i])),
+                            static_cast<coordinate_type>(transform.y(points[2 * i + 1])));
+                    }
+                    length -= static_cast<std::uint32_t>(run - 1);
+                    continue;
+                }
+            }
+
             if (cmd == CommandType::MOVE_TO && !paths.back().empty()) {
                 if (paths.back().size() < paths.back().capacity()) {
                     // Assuming we had an invalid length before
@@ -319,23 +1308,21 @@ GeometryCollectionType feature::getGeometries(float scale) const {
                 }
             }
 
-            x += protozero::decode_zigzag32(static_cast<std::uint32_t>(*start_itr++));
-            y += protozero::decode_zigzag32(static_cast<std::uint32_t>(*start_itr++));
-            float px = ::roundf(static_cast<float>(x) * scale);
-            float py = ::roundf(static_cast<float>(y) * scale);
-            static const float max_coord = static_cast<float>(std::numeric_limits<typename GeometryCollectionType::coordinate_type>::max());
-            static const float min_coord = static_cast<float>(std::numeric_limits<typename GeometryCollectionType::coordinate_type>::min());
-
-            if (px > max_coord ||
-                px < min_coord ||
-                py > max_coord ||
-                py < min_coord
-                ) {
+            x += protozero::decode_zigzag32(reader.next());
+            y += protozero::decode_zigzag32(reader.next());
+            // The range proof only covers int32 coordinates, which runs
+            // always are
+            const auto px = transform.x(CheckRange ? x : detail::checked_coordinate(x));
+            const auto py = transform.y(CheckRange ? y : detail::checked_coordinate(y));
+
+            if (CheckRange &&
+                (!detail::coordinate_in_range<coordinate_type>(px) ||
+                 !detail::coordinate_in_range<coordinate_type>(py))) {
                 throw std::runtime_error("paths outside valid range of coordinate_type");
             } else {
                 paths.back().emplace_back(
-                    static_cast<typename GeometryCollectionType::coordinate_type>(px),
-                    static_cast<typename GeometryCollectionType::coordinate_type>(py));
+                    static_cast<coordinate_type>(px),
+                    static_cast<coordinate_type>(py));
             }
         } else if (cmd == CommandType::CLOSE) {
             if (!paths.back().empty()) {
@@ -346,6 +1333,10 @@ GeometryCollectionType feature::getGeometries(float scale) const {
             throw std::runtime_error("unknown command");
         }
     }
+    if (!paths.back().empty() && paths.back().size() < paths.back().capacity()) {
+        // The last path's command count was invalid too
+        paths.back().shrink_to_fit();
+    }
     if (paths.size() < paths.capacity()) {
         // Assuming we had an invalid length before
         // lets shrink to fit, just to make sure
@@ -361,60 +1352,201 @@ GeometryCollectionType feature::getGeometries(float scale) const {
     return paths;
 }
 
+template <typename Sink>
+void feature::decodeGeometry(Sink&& sink) const {
+    detail::decode_geometry(geometry, sink);
+}
+
+template <typename CoordinateType, typename Transform>
+mapbox::geometry::multi_polygon<CoordinateType> feature::getMultiPolygon(Transform const& transform) const {
+    mapbox::geometry::multi_polygon<CoordinateType> result;
+    if (type != GeomType::POLYGON) {
+        return result;
+    }
+    const detail::point_mapper<CoordinateType, Transform> map(
+        transform, !detail::transform_in_range<CoordinateType>(transform));
+    detail::multi_polygon_sink<CoordinateType, Transform> sink(result, map);
+    detail::decode_geometry(geometry, sink);
+    sink.finish();
+    return result;
+}
+
+template <typename CoordinateType, typename Transform>
+mapbox::geometry::geometry<CoordinateType> feature::getGeometry(Transform const& transform) const {
+    return buildGeometry<CoordinateType>(transform, [this](auto& sink) {
+        detail::decode_geometry(geometry, sink);
+    });
+}
+
+template <typename CoordinateType, typename Transform>
+mapbox::geometry::geometry<CoordinateType> feature::getClippedGeometry(bbox_type const& clip, Transform const& transform) const {
+    return buildGeometry<CoordinateType>(transform, [this, &clip](auto& sink) {
+        decodeClippedGeometry(clip, sink);
+    });
+}
+
+template <typename Sink>
+void feature::decodeClippedGeometry(bbox_type const& clip, Sink&& sink) const {
+    switch (type) {
+    case GeomType::POINT: {
+        detail::point_clipper<typename std::remove_reference<Sink>::type> clipper(clip, sink);
+        detail::decode_geometry(geometry, clipper);
+        break;
+    }
+    case GeomType::LINESTRING: {
+        detail::line_clipper<typename std::remove_reference<Sink>::type> clipper(clip, sink);
+        detail::decode_geometry(geometry, clipper);
+        break;
+    }
+    case GeomType::POLYGON: {
+        detail::polygon_clipper<typename std::remove_reference<Sink>::type> clipper(clip, sink);
+        detail::decode_geometry(geometry, clipper);
+        clipper.finish();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+template <typename Sink>
+void feature::decodeSimplifiedGeometry(double tolerance, Sink&& sink) const {
+    if (type == GeomType::POINT) {
+        detail::decode_geometry(geometry, sink);
+        return;
+    }
+    detail::simplifier<typename std::remove_reference<Sink>::type> simplifier(tolerance, sink);
+    detail::decode_geometry(geometry, simplifier);
+    simplifier.finish();
+}
+
+template <typename GeometryCollectionType>
+GeometryCollectionType feature::getSimplifiedGeometries(double tolerance, float scale) const {
+    return withScaleTransform<GeometryCollectionType>(scale, [this, tolerance](auto const& transform) {
+        return this->template buildSimplifiedGeometries<GeometryCollectionType>(tolerance, transform);
+    });
+}
+
+template <typename GeometryCollectionType, typename Transform>
+GeometryCollectionType feature::buildSimplifiedGeometries(double tolerance, Transform const& transform) const {
+    using coordinate_type = typename GeometryCollectionType::coordinate_type;
+    const detail::point_mapper<coordinate_type, Transform> map(
+        transform, !detail::transform_in_range<coordinate_type>(transform));
+    GeometryCollectionType paths;
+    detail::paths_sink<GeometryCollectionType, Transform> sink{paths, map};
+    decodeSimplifiedGeometry(tolerance, sink);
+    return paths;
+}
+
+// Builds the mapbox::geometry alternative for the feature type from the
+// points `decode(sink)` passes to the sink
+template <typename CoordinateType, typename Transform, typename Decode>
+mapbox::geometry::geometry<CoordinateType> feature::buildGeometry(Transform const& transform, Decode const& decode) const {
+    const detail::point_mapper<CoordinateType, Transform> map(
+        transform, !detail::transform_in_range<CoordinateType>(transform));
+    switch (type) {
+    case GeomType::POINT: {
+        mapbox::geometry::multi_point<CoordinateType> points;
+        detail::multi_point_sink<CoordinateType, Transform> sink{points, map};
+        decode(sink);
+        if (points.size() == 1) {
+            return points.front();
+        } else if (!points.empty()) {
+            return points;
+        }
+        break;
+    }
+    case GeomType::LINESTRING: {
+        mapbox::geometry::multi_line_string<CoordinateType> lines;
+        detail::multi_line_string_sink<CoordinateType, Transform> sink{lines, map};
+        decode(sink);
+        sink.finish();
+        if (lines.size() == 1) {
+            return std::move(lines.front());
+        } else if (!lines.empty()) {
+            return lines;
+        }
+        break;
+    }
+    case GeomType::POLYGON: {
+        mapbox::geometry::multi_polygon<CoordinateType> polygons;
+        detail::multi_polygon_sink<CoordinateType, Transform> sink(polygons, map);
+        decode(sink);
+        sink.finish();
+        if (polygons.size() == 1) {
+            return std::move(polygons.front());
+        } else if (!polygons.empty()) {
+            return polygons;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return mapbox::geometry::empty();
+}
+
+inline bbox_type feature::getBBox() const {
+    detail::bbox_sink sink;
+    detail::decode_geometry(geometry, sink);
+    return sink.box();
+}
+
 inline buffer::buffer(std::string const& data)
-    : layers() {
+    : buffer(protozero::data_view(data.data(), data.size())) {}
+
+inline buffer::buffer(const char* data, std::size_t size)
+    : buffer(protozero::data_view(data, size)) {}
+
+inline buffer::buffer(protozero::data_view const& data)
+    : layers(),
+      fields() {
         protozero::pbf_reader data_reader(data);
         while (data_reader.next(TileType::LAYERS)) {
             const protozero::data_view layer_view = data_reader.get_view();
-            protozero::pbf_reader layer_reader(layer_view);
-            std::string name;
-            bool has_name = false;
-            while (layer_reader.next(LayerType::NAME)) {
-                name = layer_reader.get_string();
-                has_name = true;
-            }
-            if (!has_name) {
+            // The only walk over the layer's fields, getLayer reuses them
+            layer_fields layer_index(layer_view);
+            if (!layer_index.has_name) {
                 throw std::runtime_error("Layer missing name");
             }
-            layers.emplace(name, layer_view);
+            if (findLayer(layer_index.name) == layers.end()) {
+                layers.emplace_back(layer_index.name, layer_view);
+                fields.push_back(std::move(layer_index));
+            }
         }
 }
 
+inline buffer::layers_type::const_iterator buffer::findLayer(protozero::data_view const& name) const {
+    // Tiles carry a handful of layers, so a linear scan beats any hashing
+    return std::find_if(layers.begin(), layers.end(), [&name](layers_type::value_type const& entry) {
+        return entry.first == name;
+    });
+}
+
 inline std::vector<std::string> buffer::layerNames() const {
     std::vector<std::string> names;
     names.reserve(layers.size());
     for (auto const& layer : layers) {
-        names.emplace_back(layer.first);
+        names.emplace_back(layer.first.data(), layer.first.size());
     }
     return names;
 }
 
 inline layer buffer::getLayer(const std::string& name) const {
-    auto layer_it = layers.find(name);
+    auto layer_it = findLayer(protozero::data_view(name.data(), name.size()));
     if (layer_it == layers.end()) {
         throw std::runtime_error(std::string("no layer by the name of '")+name+"'");
     }
-    return layer(layer_it->second);
+    return layer(fields[static_cast<std::size_t>(layer_it - layers.begin())]);
 }
 
-inline layer::layer(protozero::data_view const& layer_view) :
-    name(),
-    version(1),
-    extent(4096),
-    keysMap(),
-    keys(),
-    values(),
-    features()
-{
-    bool has_name = false;
-    bool has_extent = false;
-    bool has_version = false;
+inline layer_fields::layer_fields(protozero::data_view const& layer_view) {
     protozero::pbf_reader layer_pbf(layer_view);
     while (layer_pbf.next()) {
         switch (layer_pbf.tag()) {
         case LayerType::NAME:
             {
-                name = layer_pbf.get_string();
+                name = layer_pbf.get_view();
                 has_name = true;
             }
             break;
@@ -427,8 +1559,7 @@ inline layer::layer(protozero::data_view const& layer_view) :
             {
                 // We want to keep the keys in the order of the vector tile
                 // https://github.com/mapbox/mapbox-gl-native/pull/5183
-                auto iter = keysMap.emplace(layer_pbf.get_string(), keys.size());
-                keys.emplace_back(std::reference_wrapper<const std::string>(iter->first));
+                keys.emplace_back(layer_pbf.get_view());
             }
             break;
         case LayerType::VALUES:
@@ -455,6 +1586,9 @@ inline layer::layer(protozero::data_view const& layer_view) :
             break;
         }
     }
+}
+
+inline void layer_fields::checkRequired() const {
     if (!has_version || !has_name || !has_extent) {
         std::string msg("missing required field:");
         if (!has_version) {
@@ -470,6 +1604,259 @@ inline layer::layer(protozero::data_view const& layer_view) :
     }
 }
 
+inline layer::layer(protozero::data_view const& layer_view)
+    : layer(layer_fields(layer_view)) {}
+
+inline layer::layer(layer_fields fields) :
+    name(fields.name.data(), fields.name.size()),
+    version(fields.version),
+    extent(fields.extent),
+    keys(std::move(fields.keys)),
+    keysTable(),
+    nextDuplicate(),
+    values(std::move(fields.values)),
+    decodedValues(),
+    malformedValues(),
+    featureBoxes(),
+    featureIndex(),
+    indexed(false),
+    features(std::move(fields.features))
+{
+    fields.checkRequired();
+    buildKeysTable();
+    decodedValues.reserve(values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        try {
+            decodedValues.push_back(parseValueView(values[i]));
+        } catch (protozero::exception const&) {
+            decodedValues.emplace_back();
+            malformedValues.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+inline void layer::buildKeysTable() {
+    if (keys.empty()) {
+        return;
+    }
+    // Power of two capacity at most half full keeps probe sequences short
+    std::size_t capacity = 8;
+    while (capacity < keys.size() * 2) {
+        capacity *= 2;
+    }
+    keysTable.assign(capacity, 0);
+    nextDuplicate.assign(keys.size(), detail::no_slot);
+    const std::size_t mask = capacity - 1;
+    // Going backwards leaves the first occurrence of each key in its slot,
+    // with the later ones chained behind it in tile order
+    for (std::size_t i = keys.size(); i-- > 0;) {
+        std::size_t slot = detail::hash_bytes(keys[i]) & mask;
+        while (keysTable[slot] != 0 && keys[keysTable[slot] - 1] != keys[i]) {
+            slot = (slot + 1) & mask;
+        }
+        if (keysTable[slot] != 0) {
+            nextDuplicate[i] = keysTable[slot] - 1;
+        }
+        keysTable[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+}
+
+template <typename F>
+void layer::forEachKeyIndex(protozero::data_view const& key, F&& f) const {
+    if (keysTable.empty()) {
+        return;
+    }
+    const std::size_t mask = keysTable.size() - 1;
+    std::size_t slot = detail::hash_bytes(key) & mask;
+    while (keysTable[slot] != 0) {
+        std::uint32_t index = keysTable[slot] - 1;
+        if (keys[index] == key) {
+            for (; index != detail::no_slot; index = nextDuplicate[index]) {
+                f(index);
+            }
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+inline void layer::decodeGeometries(layer_geometry_buffer& out) const {
+    out.clear();
+    out.features.reserve(features.size());
+    out.types.reserve(features.size());
+    for (auto const& feature_view : features) {
+        GeomType geom_type;
+        const protozero::data_view geometry = detail::feature_geometry(feature_view, geom_type);
+        out.features.push_back(static_cast<std::uint32_t>(out.geometry.ringCount()));
+        out.types.push_back(geom_type);
+        detail::feature_geometry_sink sink{out.geometry};
+        detail::decode_geometry(geometry, sink);
+    }
+}
+
+inline void layer::getBBoxes(std::vector<bbox_type>& out) const {
+    out.clear();
+    out.reserve(features.size());
+    for (auto const& feature_view : features) {
+        GeomType geom_type;
+        detail::bbox_sink sink;
+        detail::decode_geometry(detail::feature_geometry(feature_view, geom_type), sink);
+        out.push_back(sink.box());
+    }
+}
+
+inline void layer::buildIndex() {
+    getBBoxes(featureBoxes);
+    featureIndex.build(featureBoxes);
+    indexed = true;
+}
+
+// Appends, in ascending order, the features whose bounding box intersects `box`
+inline void layer::appendCandidates(bbox_type const& box, std::vector<std::size_t>& out) const {
+    if (box.min.x > box.max.x || box.min.y > box.max.y) {
+        return;
+    }
+    if (indexed) {
+        featureIndex.query(featureBoxes, box, out);
+        return;
+    }
+    for (std::size_t i = 0; i < features.size(); ++i) {
+        GeomType geom_type;
+        detail::bbox_sink sink;
+        detail::decode_geometry(detail::feature_geometry(features[i], geom_type), sink);
+        const bbox_type b = sink.box();
+        if (!(b.max.x < box.min.x || b.min.x > box.max.x || b.max.y < box.min.y || b.min.y > box.max.y)) {
+            out.push_back(i);
+        }
+    }
+}
+
+inline void layer::queryBBox(bbox_type const& box, std::vector<std::size_t>& out) const {
+    out.clear();
+    appendCandidates(box, out);
+}
+
+// Bounding box of everything within `tolerance` of (x, y)
+inline bbox_type layer::reach(std::int32_t x, std::int32_t y, double tolerance) const {
+    const double r = std::ceil(std::max(0.0, tolerance));
+    const auto clamp = [](double v) {
+        return static_cast<std::int32_t>(std::min<double>(std::numeric_limits<std::int32_t>::max(),
+                                                          std::max<double>(std::numeric_limits<std::int32_t>::min(), v)));
+    };
+    return bbox_type({clamp(x - r), clamp(y - r)}, {clamp(x + r), clamp(y + r)});
+}
+
+inline void layer::queryPoint(std::int32_t x, std::int32_t y, double tolerance, std::vector<std::size_t>& out,
+                              query_buffer& scratch) const {
+    scratch.candidates.clear();
+    appendCandidates(reach(x, y, tolerance), scratch.candidates);
+    out.clear();
+    geometry_buffer& geometry = scratch.geometry;
+    for (const std::size_t index : scratch.candidates) {
+        GeomType geom_type;
+        geometry.clear();
+        detail::decode_geometry(detail::feature_geometry(features[index], geom_type), geometry);
+        if (detail::hit_test(geometry, geom_type, x, y, tolerance)) {
+            out.push_back(index);
+        }
+    }
+}
+
+inline void layer::queryPoint(std::int32_t x, std::int32_t y, double tolerance, std::vector<std::size_t>& out) const {
+    query_buffer scratch;
+    queryPoint(x, y, tolerance, out, scratch);
+}
+
+inline void layer::queryPoints(std::vector<mapbox::geometry::point<std::int32_t>> const& points, double tolerance,
+                               std::vector<std::vector<std::size_t>>& out, query_buffer& scratch) const {
+    out.resize(points.size());
+    for (auto& hits : out) {
+        hits.clear();
+    }
+    // (feature, point) pairs sorted by feature, so every candidate is
+    // decoded once for all the points near it
+    auto& candidates = scratch.pairs;
+    auto& found = scratch.candidates;
+    candidates.clear();
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        found.clear();
+        appendCandidates(reach(points[i].x, points[i].y, tolerance), found);
+        for (const std::size_t index : found) {
+            candidates.emplace_back(index, i);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    geometry_buffer& geometry = scratch.geometry;
+    GeomType geom_type = GeomType::UNKNOWN;
+    std::size_t decoded = features.size();
+    for (auto const& candidate : candidates) {
+        if (candidate.first != decoded) {
+            geometry.clear();
+            detail::decode_geometry(detail::feature_geometry(features[candidate.first], geom_type), geometry);
+            decoded = candidate.first;
+        }
+        auto const& p = points[candidate.second];
+        if (detail::hit_test(geometry, geom_type, p.x, p.y, tolerance)) {
+            out[candidate.second].push_back(candidate.first);
+        }
+    }
+}
+
+inline void layer::queryPoints(std::vector<mapbox::geometry::point<std::int32_t>> const& points, double tolerance,
+                               std::vector<std::vector<std::size_t>>& out) const {
+    query_buffer scratch;
+    queryPoints(points, tolerance, out, scratch);
+}
+
+inline key_handle layer::resolveKey(std::string const& key) const {
+    key_handle result;
+    forEachKeyIndex(protozero::data_view(key.data(), key.size()), [&result](std::uint32_t index) {
+        if (result.count++ == 0) {
+            result.first = index;
+        } else {
+            result.duplicates.push_back(index);
+        }
+    });
+    return result;
+}
+
+inline key_set layer::resolveKeys(std::vector<std::string> const& names) const {
+    key_set result;
+    result.slots.assign(keys.size(), detail::no_slot);
+    result.aliases.assign(names.size(), detail::no_slot);
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        const auto slot = static_cast<std::uint32_t>(i);
+        for (std::size_t j = 0; j < i; ++j) {
+            if (names[j] == names[i]) {
+                result.aliases[i] = static_cast<std::uint32_t>(j);
+                break;
+            }
+        }
+        if (result.aliases[i] != detail::no_slot) {
+            continue;
+        }
+        bool resolved = false;
+        forEachKeyIndex(protozero::data_view(names[i].data(), names[i].size()), [&](std::uint32_t index) {
+            result.slots[index] = slot;
+            resolved = true;
+        });
+        if (resolved) {
+            ++result.resolved;
+        }
+    }
+    return result;
+}
+
+inline value_view const& layer::getValueView(std::size_t index) const {
+    value_view const& value = decodedValues.at(index);
+    if (!malformedValues.empty() && std::binary_search(malformedValues.begin(), malformedValues.end(), index)) {
+        // Throws the error decoding it ran into
+        parseValueView(values[index]);
+    }
+    return value;
+}
+
 inline protozero::data_view const& layer::getFeature(std::size_t i) const {
     return features.at(i);
 }
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <mapbox/geometry.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mapbox { namespace vector_tile { namespace detail {
+
+/**
+ * Geometry sinks that clip to a rectangle, edges included, on their way to
+ * another sink. They sit between the decoder and the sink that stores
+ * points, so nothing outside the rectangle is ever stored. Points created
+ * where the geometry crosses the rectangle are rounded to integers.
+ * Coordinates are tile coordinates by default, a wider Coordinate type
+ * allows clipping geometries that were scaled up first.
+ */
+
+template <typename Coordinate>
+inline Coordinate round_coordinate(double value) {
+    return static_cast<Coordinate>(std::llround(value));
+}
+
+// Keeps the points inside the rectangle
+template <typename Sink, typename Coordinate = std::int32_t>
+class point_clipper {
+public:
+    using clip_box = mapbox::geometry::box<Coordinate>;
+
+    point_clipper(clip_box const& clip, Sink& sink)
+        : clip_(clip),
+          sink_(sink) {}
+
+    void move_to(Coordinate x, Coordinate y) {
+        if (x >= clip_.min.x && x <= clip_.max.x && y >= clip_.min.y && y <= clip_.max.y) {
+            sink_.move_to(x, y);
+        }
+    }
+
+    void line_to(Coordinate x, Coordinate y) { move_to(x, y); }
+    void close() {}
+
+private:
+    clip_box clip_;
+    Sink& sink_;
+};
+
+// Clips every segment with Liang-Barsky, starting a new line whenever the
+// geometry comes back into the rectangle
+template <typename Sink, typename Coordinate = std::int32_t>
+class line_clipper {
+public:
+    using clip_box = mapbox::geometry::box<Coordinate>;
+
+    line_clipper(clip_box const& clip, Sink& sink)
+        : clip_(clip),
+          sink_(sink) {}
+
+    void move_to(Coordinate x, Coordinate y) {
+        started_ = true;
+        drawing_ = x >= clip_.min.x && x <= clip_.max.x && y >= clip_.min.y && y <= clip_.max.y;
+        if (drawing_) {
+            sink_.move_to(x, y);
+        }
+        prev_x_ = x;
+        prev_y_ = y;
+    }
+
+    void line_to(Coordinate x, Coordinate y) {
+        if (!started_) {
+            move_to(x, y);
+            return;
+        }
+        const Coordinate from_x = prev_x_;
+        const Coordinate from_y = prev_y_;
+        const double ax = static_cast<double>(from_x);
+        const double ay = static_cast<double>(from_y);
+        const double dx = static_cast<double>(x) - ax;
+        const double dy = static_cast<double>(y) - ay;
+        prev_x_ = x;
+        prev_y_ = y;
+        double t0 = 0.0;
+        double t1 = 1.0;
+        if (!clipT(-dx, ax - static_cast<double>(clip_.min.x), t0, t1) ||
+            !clipT(dx, static_cast<double>(clip_.max.x) - ax, t0, t1) ||
+            !clipT(-dy, ay - static_cast<double>(clip_.min.y), t0, t1) ||
+            !clipT(dy, static_cast<double>(clip_.max.y) - ay, t0, t1)) {
+            drawing_ = false;
+            return;
+        }
+        const Coordinate x1 = t1 < 1.0 ? round_coordinate<Coordinate>(ax + t1 * dx) : x;
+        const Coordinate y1 = t1 < 1.0 ? round_coordinate<Coordinate>(ay + t1 * dy) : y;
+        if (!drawing_ || t0 > 0.0) {
+            const Coordinate x0 = round_coordinate<Coordinate>(ax + t0 * dx);
+            const Coordinate y0 = round_coordinate<Coordinate>(ay + t0 * dy);
+            if (x0 == x1 && y0 == y1) {
+                // Only touches the rectangle
+                drawing_ = false;
+                return;
+            }
+            sink_.move_to(x0, y0);
+        } else if (x1 == from_x && y1 == from_y) {
+            // Nothing new to draw, e.g. leaving the rectangle right at the
+            // point emitted last
+            drawing_ = t1 >= 1.0;
+            return;
+        }
+        sink_.line_to(x1, y1);
+        drawing_ = t1 >= 1.0;
+    }
+
+    void close() {}
+
+private:
+    // Narrows [t0, t1] to the part of the segment inside one edge, where
+    // p * t <= q. Returns false if nothing is left.
+    static bool clipT(double p, double q, double& t0, double& t1) {
+        if (p < 0.0) {
+            const double t = q / p;
+            if (t > t1) {
+                return false;
+            }
+            if (t > t0) {
+                t0 = t;
+            }
+        } else if (p > 0.0) {
+            const double t = q / p;
+            if (t < t0) {
+                return false;
+            }
+            if (t < t1) {
+                t1 = t;
+            }
+        } else if (q < 0.0) {
+            // Parallel to the edge and outside it
+            return false;
+        }
+        return true;
+    }
+
+    clip_box clip_;
+    Sink& sink_;
+    bool started_ = false;
+    bool drawing_ = false;
+    Coordinate prev_x_ = 0;
+    Coordinate prev_y_ = 0;
+};
+
+// Clips rings with Sutherland-Hodgman, one stage per rectangle edge. The
+// stages are chained so each vertex flows through all four as it is
+// decoded. Rings left with fewer than three points are dropped, the others
+// are always closed. Call finish() once decoding is done.
+template <typename Sink, typename Coordinate = std::int32_t>
+class polygon_clipper {
+public:
+    using clip_box = mapbox::geometry::box<Coordinate>;
+
+    polygon_clipper(clip_box const& clip, Sink& sink)
+        : sink_(sink) {
+        stages_[0].axis = 0;
+        stages_[0].bound = static_cast<double>(clip.min.x);
+        stages_[0].keep_above = true;
+        stages_[1].axis = 0;
+        stages_[1].bound = static_cast<double>(clip.max.x);
+        stages_[1].keep_above = false;
+        stages_[2].axis = 1;
+        stages_[2].bound = static_cast<double>(clip.min.y);
+        stages_[2].keep_above = true;
+        stages_[3].axis = 1;
+        stages_[3].bound = static_cast<double>(clip.max.y);
+        stages_[3].keep_above = false;
+    }
+
+    void move_to(Coordinate x, Coordinate y) {
+        finish();
+        push(0, static_cast<double>(x), static_cast<double>(y));
+    }
+
+    void line_to(Coordinate x, Coordinate y) { push(0, static_cast<double>(x), static_cast<double>(y)); }
+
+    void close() { finish(); }
+
+    // Close the ring being decoded, if any, and pass it on
+    void finish() {
+        for (std::size_t i = 0; i < 4; ++i) {
+            stage& s = stages_[i];
+            if (s.count > 1) {
+                // The closing edge from the last point back to the first
+                edge(i, s.prev_x, s.prev_y, s.first_x, s.first_y);
+            }
+            s.count = 0;
+        }
+        // The closing point is added back by sink_.close()
+        if (ring_.size() >= 4 && ring_[0] == ring_[ring_.size() - 2] && ring_[1] == ring_.back()) {
+            ring_.resize(ring_.size() - 2);
+        }
+        if (ring_.size() >= 6) {
+            sink_.move_to(ring_[0], ring_[1]);
+            for (std::size_t i = 2; i < ring_.size(); i += 2) {
+                sink_.line_to(ring_[i], ring_[i + 1]);
+            }
+            sink_.close();
+        }
+        ring_.clear();
+    }
+
+private:
+    struct stage {
+        int axis = 0;
+        double bound = 0.0;
+        bool keep_above = true;
+        std::size_t count = 0;
+        double first_x = 0.0;
+        double first_y = 0.0;
+        double prev_x = 0.0;
+        double prev_y = 0.0;
+
+        bool inside(double x, double y) const {
+            const double v = axis == 0 ? x : y;
+            return keep_above ? v >= bound : v <= bound;
+        }
+    };
+
+    void push(std::size_t i, double x, double y) {
+        if (i == 4) {
+            emit(x, y);
+            return;
+        }
+        stage& s = stages_[i];
+        if (s.count == 0) {
+            s.first_x = x;
+            s.first_y = y;
+            if (s.inside(x, y)) {
+                push(i + 1, x, y);
+            }
+        } else {
+            edge(i, s.prev_x, s.prev_y, x, y);
+            if (s.inside(x, y)) {
+                push(i + 1, x, y);
+            }
+        }
+        ++s.count;
+        s.prev_x = x;
+        s.prev_y = y;
+    }
+
+    // Passes on where the edge from a to b crosses stage i's boundary
+    void edge(std::size_t i, double ax, double ay, double bx, double by) {
+        stage const& s = stages_[i];
+        if (s.inside(ax, ay) == s.inside(bx, by)) {
+            return;
+        }
+        if (s.axis == 0) {
+            const double t = (s.bound - ax) / (bx - ax);
+            push(i + 1, s.bound, ay + t * (by - ay));
+        } else {
+            const double t = (s.bound - ay) / (by - ay);
+            push(i + 1, ax + t * (bx - ax), s.bound);
+        }
+    }
+
+    void emit(double x, double y) {
+        const Coordinate ix = round_coordinate<Coordinate>(x);
+        const Coordinate iy = round_coordinate<Coordinate>(y);
+        if (ring_.size() >= 2 && ring_[ring_.size() - 2] == ix && ring_.back() == iy) {
+            return;
+        }
+        ring_.push_back(ix);
+        ring_.push_back(iy);
+    }
+
+    Sink& sink_;
+    stage stages_[4];
+    // Clipped ring as x, y pairs
+    std::vector<Coordinate> ring_;
+};
+
+}}} // namespace mapbox/vector_tile/detail
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <mapbox/geometry.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mapbox { namespace vector_tile { namespace detail {
+
+constexpr std::int64_t grid_max_cells_per_side = 256;
+// Boxes overlapping more cells than this are kept in a list checked by
+// every query, so that many large features do not fill every cell
+constexpr std::int64_t grid_max_cells_per_box = 16;
+
+/**
+ * Static uniform grid over the bounding boxes of a layer's features. Cells
+ * store feature indices in one packed array, each box is listed in every
+ * cell it overlaps. Empty boxes (min > max) are not indexed.
+ */
+class grid_index {
+public:
+    using box_type = mapbox::geometry::box<std::int32_t>;
+
+    void build(std::vector<box_type> const& boxes) {
+        cells_.clear();
+        items_.clear();
+        large_.clear();
+        size_ = 0;
+        bool any = false;
+        for (auto const& b : boxes) {
+            if (empty(b)) {
+                continue;
+            }
+            if (!any) {
+                min_x_ = b.min.x;
+                min_y_ = b.min.y;
+                max_x_ = b.max.x;
+                max_y_ = b.max.y;
+                any = true;
+            } else {
+                min_x_ = std::min(min_x_, b.min.x);
+                min_y_ = std::min(min_y_, b.min.y);
+                max_x_ = std::max(max_x_, b.max.x);
+                max_y_ = std::max(max_y_, b.max.y);
+            }
+        }
+        if (!any) {
+            return;
+        }
+        // About one feature per cell
+        size_ = std::min<std::int64_t>(grid_max_cells_per_side,
+                                       std::max<std::int64_t>(1, static_cast<std::int64_t>(std::ceil(std::sqrt(static_cast<double>(boxes.size()))))));
+        cell_width_ = (std::int64_t(max_x_) - min_x_) / size_ + 1;
+        cell_height_ = (std::int64_t(max_y_) - min_y_) / size_ + 1;
+
+        // Count, then fill the cells in one packed array
+        cells_.assign(static_cast<std::size_t>(size_ * size_ + 1), 0);
+        forEachCell(boxes, [this](std::size_t cell, std::uint32_t) { ++cells_[cell + 1]; });
+        for (std::size_t i = 1; i < cells_.size(); ++i) {
+            cells_[i] += cells_[i - 1];
+        }
+        items_.resize(cells_.back());
+        std::vector<std::uint32_t> fill(cells_.begin(), cells_.end() - 1);
+        forEachCell(boxes, [this, &fill](std::size_t cell, std::uint32_t index) { items_[fill[cell]++] = index; });
+        for (std::size_t i = 0; i < boxes.size(); ++i) {
+            if (!empty(boxes[i]) && large(boxes[i])) {
+                large_.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+    }
+
+    /**
+     * Append to `out`, in ascending order, the index of every box that
+     * intersects `area`, edges included.
+     */
+    void query(std::vector<box_type> const& boxes, box_type const& area, std::vector<std::size_t>& out) const {
+        if (size_ == 0 || empty(area) ||
+            area.max.x < min_x_ || area.min.x > max_x_ ||
+            area.max.y < min_y_ || area.min.y > max_y_) {
+            return;
+        }
+        const std::size_t first = out.size();
+        for (const std::uint32_t index : large_) {
+            if (intersects(boxes[index], area)) {
+                out.push_back(index);
+            }
+        }
+        const std::int64_t qx0 = cellX(area.min.x);
+        const std::int64_t qx1 = cellX(area.max.x);
+        const std::int64_t qy0 = cellY(area.min.y);
+        const std::int64_t qy1 = cellY(area.max.y);
+        for (std::int64_t cy = qy0; cy <= qy1; ++cy) {
+            for (std::int64_t cx = qx0; cx <= qx1; ++cx) {
+                const auto cell = static_cast<std::size_t>(cy * size_ + cx);
+                for (std::uint32_t i = cells_[cell]; i < cells_[cell + 1]; ++i) {
+                    const std::uint32_t index = items_[i];
+                    auto const& b = boxes[index];
+                    if (!intersects(b, area)) {
+                        continue;
+                    }
+                    // A box spanning several of the visited cells is only
+                    // reported from the first of them
+                    if (cx == std::max(qx0, cellX(b.min.x)) && cy == std::max(qy0, cellY(b.min.y))) {
+                        out.push_back(index);
+                    }
+                }
+            }
+        }
+        std::sort(out.begin() + static_cast<std::ptrdiff_t>(first), out.end());
+    }
+
+private:
+    static bool empty(box_type const& b) {
+        return b.min.x > b.max.x || b.min.y > b.max.y;
+    }
+
+    static bool intersects(box_type const& a, box_type const& b) {
+        return !(a.max.x < b.min.x || a.min.x > b.max.x ||
+                 a.max.y < b.min.y || a.min.y > b.max.y);
+    }
+
+    bool large(box_type const& b) const {
+        return (cellX(b.max.x) - cellX(b.min.x) + 1) * (cellY(b.max.y) - cellY(b.min.y) + 1) > grid_max_cells_per_box;
+    }
+
+    std::int64_t cellX(std::int32_t x) const {
+        return std::min(size_ - 1, std::max<std::int64_t>(0, (std::int64_t(x) - min_x_) / cell_width_));
+    }
+
+    std::int64_t cellY(std::int32_t y) const {
+        return std::min(size_ - 1, std::max<std::int64_t>(0, (std::int64_t(y) - min_y_) / cell_height_));
+    }
+
+    template <typename F>
+    void forEachCell(std::vector<box_type> const& boxes, F&& f) const {
+        for (std::size_t i = 0; i < boxes.size(); ++i) {
+            auto const& b = boxes[i];
+            if (empty(b) || large(b)) {
+                continue;
+            }
+            for (std::int64_t cy = cellY(b.min.y); cy <= cellY(b.max.y); ++cy) {
+                for (std::int64_t cx = cellX(b.min.x); cx <= cellX(b.max.x); ++cx) {
+                    f(static_cast<std::size_t>(cy * size_ + cx), static_cast<std::uint32_t>(i));
+                }
+            }
+        }
+    }
+
+    // Cells per side, 0 when nothing is indexed
+    std::int64_t size_ = 0;
+    std::int64_t cell_width_ = 1;
+    std::int64_t cell_height_ = 1;
+    std::int32_t min_x_ = 0;
+    std::int32_t min_y_ = 0;
+    std::int32_t max_x_ = 0;
+    std::int32_t max_y_ = 0;
+    // Feature indices of cell c are items_[cells_[c], cells_[c + 1])
+    std::vector<std::uint32_t> cells_;
+    std::vector<std::uint32_t> items_;
+    // Boxes too large for the cells, in index order
+    std::vector<std::uint32_t> large_;
+};
+
+}}} // namespace mapbox/vector_tile/detail
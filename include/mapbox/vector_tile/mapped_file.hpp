@@ -0,0 +1,141 @@
+#pragma once
+
+#include <protozero/data_view.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mapbox { namespace vector_tile {
+
+/**
+ * Read-only memory mapping of a file holding a single uncompressed tile.
+ *
+ * Pass `view()` to `buffer` to decode straight from the mapped pages
+ * without copying the tile into a `std::string` first. The mapping must
+ * outlive the buffer and every layer obtained from it.
+ */
+class mapped_file {
+public:
+    explicit mapped_file(std::string const& path);
+    ~mapped_file() { unmap(); }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    mapped_file(mapped_file&& other) noexcept
+        : data_(other.data_),
+          size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    protozero::data_view view() const { return protozero::data_view(data_, size_); }
+
+private:
+    void unmap() noexcept;
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#ifdef _WIN32
+
+inline mapped_file::mapped_file(std::string const& path) {
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("could not open: '" + path + "'");
+    }
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file, &file_size)) {
+        ::CloseHandle(file);
+        throw std::runtime_error("could not stat: '" + path + "'");
+    }
+    size_ = static_cast<std::size_t>(file_size.QuadPart);
+    if (size_ == 0) {
+        // Empty files cannot be mapped, an empty view decodes as an empty tile
+        ::CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if (mapping == nullptr) {
+        throw std::runtime_error("could not map: '" + path + "'");
+    }
+    data_ = static_cast<const char*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    ::CloseHandle(mapping);
+    if (data_ == nullptr) {
+        size_ = 0;
+        throw std::runtime_error("could not map: '" + path + "'");
+    }
+}
+
+inline void mapped_file::unmap() noexcept {
+    if (data_ != nullptr) {
+        ::UnmapViewOfFile(data_);
+    }
+}
+
+#else
+
+inline mapped_file::mapped_file(std::string const& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("could not open: '" + path + "'");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("could not stat: '" + path + "'");
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ == 0) {
+        // Empty files cannot be mapped, an empty view decodes as an empty tile
+        ::close(fd);
+        return;
+    }
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        size_ = 0;
+        throw std::runtime_error("could not map: '" + path + "'");
+    }
+    data_ = static_cast<const char*>(addr);
+}
+
+inline void mapped_file::unmap() noexcept {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#endif
+
+}} // namespace mapbox/vector_tile
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <mapbox/vector_tile.hpp>
+#include <protozero/pbf_writer.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mapbox { namespace vector_tile {
+
+struct overzoom_options {
+    // Extent of the child tile's layers, 0 keeps each parent layer's extent
+    std::uint32_t extent = 0;
+    // Child tile units of geometry kept beyond the tile's edges
+    std::uint32_t buffer = 64;
+};
+
+namespace detail {
+
+constexpr std::size_t encoder_no_run = std::numeric_limits<std::size_t>::max();
+
+inline std::uint32_t encode_command(std::uint32_t cmd, std::uint32_t count) {
+    return (count << 3) | cmd;
+}
+
+// Encodes geometry sink events as a vector tile command stream. All points
+// of a POINT feature go into one MoveTo, repeated ones included. Repeated
+// points of lines and rings are dropped, and lines left with fewer than two
+// points or rings with fewer than three are taken back out of the stream.
+class geometry_encoder {
+public:
+    void reset(GeomType type) {
+        type_ = type;
+        commands_.clear();
+        x_ = 0;
+        y_ = 0;
+        has_pending_ = false;
+        in_part_ = false;
+        run_ = encoder_no_run;
+    }
+
+    void move_to(std::int64_t x, std::int64_t y) {
+        if (type_ == GeomType::POINT) {
+            if (run_ == encoder_no_run) {
+                run_ = commands_.size();
+                run_count_ = 0;
+                commands_.push_back(0);
+            }
+            add(x, y);
+            ++run_count_;
+            return;
+        }
+        endPart();
+        pending_x_ = x;
+        pending_y_ = y;
+        has_pending_ = true;
+    }
+
+    void line_to(std::int64_t x, std::int64_t y) {
+        if (type_ == GeomType::POINT || (!has_pending_ && !in_part_)) {
+            move_to(x, y);
+            return;
+        }
+        if (has_pending_) {
+            if (x == pending_x_ && y == pending_y_) {
+                return;
+            }
+            part_start_ = commands_.size();
+            part_x_ = x_;
+            part_y_ = y_;
+            commands_.push_back(encode_command(CommandType::MOVE_TO, 1));
+            add(pending_x_, pending_y_);
+            has_pending_ = false;
+            in_part_ = true;
+            part_points_ = 1;
+        } else if (x == x_ && y == y_) {
+            return;
+        }
+        if (run_ == encoder_no_run) {
+            run_ = commands_.size();
+            run_count_ = 0;
+            commands_.push_back(0);
+        }
+        add(x, y);
+        ++run_count_;
+        ++part_points_;
+    }
+
+    void close() { endPart(); }
+
+    // Complete the command stream, empty if nothing was drawn
+    std::vector<std::uint32_t> const& finish() {
+        endPart();
+        return commands_;
+    }
+
+private:
+    void add(std::int64_t x, std::int64_t y) {
+        commands_.push_back(protozero::encode_zigzag32(static_cast<std::int32_t>(x - x_)));
+        commands_.push_back(protozero::encode_zigzag32(static_cast<std::int32_t>(y - y_)));
+        x_ = x;
+        y_ = y;
+    }
+
+    void endRun() {
+        if (run_ != encoder_no_run) {
+            const std::uint32_t cmd = type_ == GeomType::POINT ? CommandType::MOVE_TO : CommandType::LINE_TO;
+            commands_[run_] = encode_command(cmd, run_count_);
+            run_ = encoder_no_run;
+        }
+    }
+
+    void endPart() {
+        endRun();
+        has_pending_ = false;
+        if (!in_part_) {
+            return;
+        }
+        in_part_ = false;
+        const bool polygon = type_ == GeomType::POLYGON;
+        if (part_points_ < (polygon ? 3u : 2u)) {
+            commands_.resize(part_start_);
+            x_ = part_x_;
+            y_ = part_y_;
+        } else if (polygon) {
+            commands_.push_back(encode_command(CommandType::CLOSE, 1));
+        }
+    }
+
+    GeomType type_ = GeomType::UNKNOWN;
+    std::vector<std::uint32_t> commands_;
+    // Cursor, which deltas are relative to
+    std::int64_t x_ = 0;
+    std::int64_t y_ = 0;
+    // MoveTo held back until the line or ring gets a second point
+    std::int64_t pending_x_ = 0;
+    std::int64_t pending_y_ = 0;
+    bool has_pending_ = false;
+    // Where the current line or ring starts, to take it back out
+    bool in_part_ = false;
+    std::size_t part_start_ = 0;
+    std::int64_t part_x_ = 0;
+    std::int64_t part_y_ = 0;
+    std::uint32_t part_points_ = 0;
+    // Index of the open command header whose count is patched in later
+    std::size_t run_ = encoder_no_run;
+    std::uint32_t run_count_ = 0;
+};
+
+// 2^63, the first double past the int64 range
+constexpr double int64_limit = 9223372036854775808.0;
+
+// Maps parent tile coordinates into the child tile's coordinates
+template <typename Sink>
+struct child_tile_sink {
+    Sink& sink;
+    affine_transform const& transform;
+
+    void move_to(std::int32_t x, std::int32_t y) { sink.move_to(checked(transform.x(x)), checked(transform.y(y))); }
+    void line_to(std::int32_t x, std::int32_t y) { sink.line_to(checked(transform.x(x)), checked(transform.y(y))); }
+    void close() { sink.close(); }
+
+    // Only an extreme zoom or extent ratio leaves the int64 range
+    static std::int64_t checked(double value) {
+        if (!(value < int64_limit && value > -int64_limit)) {
+            throw std::runtime_error("overzoomed coordinate out of range");
+        }
+        return static_cast<std::int64_t>(value);
+    }
+};
+
+} // namespace detail
+
+/**
+ * Cut the child tile at (dz, dx, dy) relative to `parent` out of it and
+ * encode it as a new vector tile: dz levels deeper, at column dx and row
+ * dy among the 2^dz x 2^dz children. Geometries are scaled to the child's
+ * extent and clipped while decoding to the tile plus `options.buffer`
+ * units. Feature ids and tags and the layers' keys and values are copied
+ * as encoded, without decoding them. Features with nothing left after
+ * clipping, features of UNKNOWN type and empty layers are left out.
+ */
+inline std::string overzoom(protozero::data_view const& parent,
+                            std::uint32_t dz, std::uint32_t dx, std::uint32_t dy,
+                            overzoom_options const& options = overzoom_options()) {
+    if (dz > 24 || dx >= (1u << dz) || dy >= (1u << dz)) {
+        throw std::runtime_error("invalid child tile address");
+    }
+    const double tiles = static_cast<double>(1u << dz);
+    const buffer tile(parent);
+    std::string result;
+    protozero::pbf_writer tile_writer(result);
+    std::string layer_data;
+    std::string feature_data;
+    detail::geometry_encoder encoder;
+
+    // The fields the buffer read while finding the layers, so every layer
+    // is walked once and named the same way as by buffer::getLayer
+    for (auto const& fields : tile.getLayerFields()) {
+        // Parents that buffer::getLayer would reject are not overzoomed either
+        fields.checkRequired();
+        const std::uint32_t extent = fields.extent;
+        if (extent == 0) {
+            throw std::runtime_error("layer extent must be greater than zero");
+        }
+        const std::uint32_t child_extent = options.extent > 0 ? options.extent : extent;
+        const auto border = static_cast<std::int64_t>(options.buffer);
+        // Clipped points lie within [-buffer, extent + buffer], so this keeps
+        // every coordinate and every delta between them within int32
+        if (child_extent + 2 * border > std::numeric_limits<std::int32_t>::max()) {
+            throw std::runtime_error("overzoom extent and buffer exceed the coordinate range");
+        }
+        const mapbox::geometry::box<std::int64_t> clip({-border, -border},
+                                                      {child_extent + border, child_extent + border});
+
+        const affine_transform transform(static_cast<double>(child_extent) * tiles / static_cast<double>(extent),
+                                         -static_cast<double>(dx) * child_extent,
+                                         -static_cast<double>(dy) * child_extent);
+
+        layer_data.clear();
+        protozero::pbf_writer layer_writer(layer_data);
+        layer_writer.add_string(LayerType::NAME, fields.name);
+        std::size_t written = 0;
+        for (auto const& feature_view : fields.features) {
+            bool has_id = false;
+            std::uint64_t id = 0;
+            GeomType type = GeomType::UNKNOWN;
+            protozero::data_view tags;
+            protozero::data_view geometry;
+            protozero::pbf_reader feature_pbf(feature_view);
+            while (feature_pbf.next()) {
+                switch (feature_pbf.tag()) {
+                case FeatureType::ID:
+                    id = feature_pbf.get_uint64();
+                    has_id = true;
+                    break;
+                case FeatureType::TAGS:
+                    tags = feature_pbf.get_view();
+                    break;
+                case FeatureType::TYPE:
+                    type = static_cast<GeomType>(feature_pbf.get_enum());
+                    break;
+                case FeatureType::GEOMETRY:
+                    geometry = feature_pbf.get_view();
+                    break;
+                default:
+                    feature_pbf.skip();
+                    break;
+                }
+            }
+
+            encoder.reset(type);
+            if (type == GeomType::POINT) {
+                detail::point_clipper<detail::geometry_encoder, std::int64_t> clipper(clip, encoder);
+                detail::child_tile_sink<decltype(clipper)> sink{clipper, transform};
+                detail::decode_geometry(geometry, sink);
+            } else if (type == GeomType::LINESTRING) {
+                detail::line_clipper<detail::geometry_encoder, std::int64_t> clipper(clip, encoder);
+                detail::child_tile_sink<decltype(clipper)> sink{clipper, transform};
+                detail::decode_geometry(geometry, sink);
+            } else if (type == GeomType::POLYGON) {
+                detail::polygon_clipper<detail::geometry_encoder, std::int64_t> clipper(clip, encoder);
+                detail::child_tile_sink<decltype(clipper)> sink{clipper, transform};
+                detail::decode_geometry(geometry, sink);
+                clipper.finish();
+            }
+            auto const& commands = encoder.finish();
+            if (commands.empty()) {
+                continue;
+            }
+
+            feature_data.clear();
+            protozero::pbf_writer feature_writer(feature_data);
+            if (has_id) {
+                feature_writer.add_uint64(FeatureType::ID, id);
+            }
+            if (tags.size() > 0) {
+                // Packed fields are length delimited, so the tags are copied as they are
+                feature_writer.add_bytes(FeatureType::TAGS, tags);
+            }
+            feature_writer.add_enum(FeatureType::TYPE, static_cast<std::int32_t>(type));
+            feature_writer.add_packed_uint32(FeatureType::GEOMETRY, commands.begin(), commands.end());
+            layer_writer.add_message(LayerType::FEATURES, feature_data);
+            ++written;
+        }
+        if (written == 0) {
+            continue;
+        }
+        for (auto const& key : fields.keys) {
+            layer_writer.add_string(LayerType::KEYS, key);
+        }
+        for (auto const& value : fields.values) {
+            layer_writer.add_message(LayerType::VALUES, value);
+        }
+        layer_writer.add_uint32(LayerType::EXTENT, child_extent);
+        layer_writer.add_uint32(LayerType::VERSION, fields.version);
+        tile_writer.add_message(TileType::LAYERS, layer_data);
+    }
+    return result;
+}
+
+}} // namespace mapbox/vector_tile
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mapbox { namespace vector_tile { namespace detail {
+
+inline double segment_distance_squared(double px, double py,
+                                       double ax, double ay,
+                                       double bx, double by) {
+    const double dx = bx - ax;
+    const double dy = by - ay;
+    const double length_squared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (length_squared > 0.0) {
+        t = std::min(1.0, std::max(0.0, ((px - ax) * dx + (py - ay) * dy) / length_squared));
+    }
+    const double ex = ax + t * dx - px;
+    const double ey = ay + t * dy - py;
+    return ex * ex + ey * ey;
+}
+
+/**
+ * Geometry sink that simplifies lines and rings with Douglas-Peucker on
+ * their way to another sink. Repeated points are dropped as they arrive,
+ * and each line or ring is simplified when it ends, so the sink behind it
+ * only ever stores the points that are kept. Closed rings stay closed and
+ * keep at least three distinct points: a ring that would collapse is
+ * passed on unsimplified. Call finish() once decoding is done.
+ */
+template <typename Sink>
+class simplifier {
+public:
+    simplifier(double tolerance, Sink& sink)
+        : tolerance_squared_(tolerance * tolerance),
+          sink_(sink) {}
+
+    void move_to(std::int32_t x, std::int32_t y) {
+        finish();
+        add(x, y);
+    }
+
+    void line_to(std::int32_t x, std::int32_t y) { add(x, y); }
+
+    void close() {
+        closed_ = !points_.empty();
+        finish();
+    }
+
+    // Simplify the line or ring being decoded, if any, and pass it on
+    void finish() {
+        if (points_.empty()) {
+            return;
+        }
+        if (closed_ && points_.size() > 2 && points_.front() != points_.back()) {
+            points_.push_back(points_.front());
+        }
+        const std::size_t kept = simplify();
+        if (closed_ && kept < 4) {
+            std::fill(keep_.begin(), keep_.end(), true);
+        }
+        // A closed ring is passed on without its closing point, which the
+        // sink adds back on close()
+        const bool has_closing_point = closed_ && points_.size() > 1 && points_.front() == points_.back();
+        const std::size_t end = has_closing_point ? points_.size() - 1 : points_.size();
+        bool first = true;
+        for (std::size_t i = 0; i < end; ++i) {
+            if (!keep_[i]) {
+                continue;
+            }
+            if (first) {
+                sink_.move_to(points_[i].first, points_[i].second);
+                first = false;
+            } else {
+                sink_.line_to(points_[i].first, points_[i].second);
+            }
+        }
+        if (closed_) {
+            sink_.close();
+        }
+        points_.clear();
+        closed_ = false;
+    }
+
+private:
+    void add(std::int32_t x, std::int32_t y) {
+        if (!points_.empty() && points_.back().first == x && points_.back().second == y) {
+            return;
+        }
+        points_.emplace_back(x, y);
+    }
+
+    // Marks the points to keep in keep_ and returns how many there are
+    std::size_t simplify() {
+        const std::size_t n = points_.size();
+        keep_.assign(n, n <= 2);
+        if (n <= 2) {
+            return n;
+        }
+        keep_.front() = true;
+        keep_.back() = true;
+        std::size_t kept = 2;
+        stack_.clear();
+        stack_.emplace_back(0, n - 1);
+        while (!stack_.empty()) {
+            const std::size_t first = stack_.back().first;
+            const std::size_t last = stack_.back().second;
+            stack_.pop_back();
+            double max_distance = tolerance_squared_;
+            std::size_t index = first;
+            for (std::size_t i = first + 1; i < last; ++i) {
+                const double distance = segment_distance_squared(points_[i].first, points_[i].second,
+                                                                 points_[first].first, points_[first].second,
+                                                                 points_[last].first, points_[last].second);
+                if (distance > max_distance) {
+                    max_distance = distance;
+                    index = i;
+                }
+            }
+            if (index != first) {
+                keep_[index] = true;
+                ++kept;
+                stack_.emplace_back(first, index);
+                stack_.emplace_back(index, last);
+            }
+        }
+        return kept;
+    }
+
+    double tolerance_squared_;
+    Sink& sink_;
+    bool closed_ = false;
+    std::vector<std::pair<std::int32_t, std::int32_t>> points_;
+    std::vector<bool> keep_;
+    std::vector<std::pair<std::size_t, std::size_t>> stack_;
+};
+
+}}} // namespace mapbox/vector_tile/detail
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace mapbox { namespace vector_tile {
+
+/**
+ * Coordinate transform policies for feature::getGeometries.
+ *
+ * A policy maps decoded tile coordinates with `x(std::int64_t)` and
+ * `y(std::int64_t)`. Both must be monotonic and defined for any value in
+ * the int32 range, since geometries are range checked from transformed
+ * bounds rather than point by point. Integer policies return
+ * `std::int64_t` so the common cases never touch floating point.
+ */
+
+/// Tile coordinates unchanged.
+struct identity_transform {
+    std::int64_t x(std::int64_t value) const { return value; }
+    std::int64_t y(std::int64_t value) const { return value; }
+};
+
+namespace detail {
+
+// value / 2^shift rounded half away from zero, like roundf
+inline std::int64_t shift_right_rounded(std::int64_t value, unsigned shift) {
+    const std::int64_t half = std::int64_t(1) << (shift - 1);
+    return value >= 0 ? (value + half) >> shift : -((-value + half) >> shift);
+}
+
+// Whether `scale` is 2^shift with shift within [-31, 31], setting `shift`
+inline bool power_of_two_shift(float scale, int& shift) {
+    if (!(scale > 0.0f) || !std::isfinite(scale)) {
+        return false;
+    }
+    int exponent = 0;
+    const float mantissa = std::frexp(scale, &exponent);
+    if (mantissa < 0.5f || mantissa > 0.5f) {
+        return false;
+    }
+    shift = exponent - 1;
+    return shift >= -31 && shift <= 31;
+}
+
+} // namespace detail
+
+/// Scale by a power of two: 2^shift, where a negative shift scales down.
+class shift_transform {
+public:
+    explicit shift_transform(int shift) : shift_(shift) {}
+
+    std::int64_t x(std::int64_t value) const { return apply(value); }
+    std::int64_t y(std::int64_t value) const { return apply(value); }
+
+private:
+    std::int64_t apply(std::int64_t value) const {
+        if (shift_ >= 0) {
+            return value * (std::int64_t(1) << shift_);
+        }
+        return detail::shift_right_rounded(value, static_cast<unsigned>(-shift_));
+    }
+
+    int shift_;
+};
+
+/// Scale by an arbitrary factor in integer arithmetic with 16 fractional bits.
+class fixed_point_transform {
+public:
+    static constexpr unsigned fraction_bits = 16;
+
+    explicit fixed_point_transform(double scale)
+        : factor_(std::llround(scale * static_cast<double>(std::int64_t(1) << fraction_bits))) {}
+
+    std::int64_t x(std::int64_t value) const { return detail::shift_right_rounded(value * factor_, fraction_bits); }
+    std::int64_t y(std::int64_t value) const { return detail::shift_right_rounded(value * factor_, fraction_bits); }
+
+private:
+    std::int64_t factor_;
+};
+
+/// `roundf(value * scale)`, the transform behind getGeometries(float scale) for scales that are not powers of two.
+class scale_transform {
+public:
+    explicit scale_transform(float scale) : scale_(scale) {}
+
+    float x(std::int64_t value) const { return ::roundf(static_cast<float>(value) * scale_); }
+    float y(std::int64_t value) const { return ::roundf(static_cast<float>(value) * scale_); }
+
+private:
+    float scale_;
+};
+
+/// `round(value * scale + offset)` per axis, e.g. to cut an overzoomed child tile out of its parent.
+class affine_transform {
+public:
+    affine_transform(double scale, double offset_x, double offset_y)
+        : scale_(scale),
+          offset_x_(offset_x),
+          offset_y_(offset_y) {}
+
+    double x(std::int64_t value) const { return std::round(static_cast<double>(value) * scale_ + offset_x_); }
+    double y(std::int64_t value) const { return std::round(static_cast<double>(value) * scale_ + offset_y_); }
+
+private:
+    double scale_;
+    double offset_x_;
+    double offset_y_;
+};
+
+/// Mirror y within the tile extent, for consumers with the origin at the bottom left.
+class y_flip_transform {
+public:
+    explicit y_flip_transform(std::uint32_t extent) : extent_(extent) {}
+
+    std::int64_t x(std::int64_t value) const { return value; }
+    std::int64_t y(std::int64_t value) const { return extent_ - value; }
+
+private:
+    std::int64_t extent_;
+};
+
+namespace detail {
+
+template <typename CoordinateType, typename Value>
+inline typename std::enable_if<std::is_floating_point<CoordinateType>::value &&
+                               !std::is_floating_point<Value>::value, bool>::type
+coordinate_in_range(Value) {
+    return true;
+}
+
+template <typename CoordinateType, typename Value>
+inline typename std::enable_if<!std::is_floating_point<CoordinateType>::value ||
+                               std::is_floating_point<Value>::value, bool>::type
+coordinate_in_range(Value value) {
+    return !(value > static_cast<Value>(std::numeric_limits<CoordinateType>::max()) ||
+             value < static_cast<Value>(std::numeric_limits<CoordinateType>::lowest()));
+}
+
+// Whether `transform` maps every int32 coordinate into CoordinateType
+template <typename CoordinateType, typename Transform>
+inline bool transform_in_range(Transform const& transform) {
+    constexpr std::int64_t min = std::numeric_limits<std::int32_t>::min();
+    constexpr std::int64_t max = std::numeric_limits<std::int32_t>::max();
+    return coordinate_in_range<CoordinateType>(transform.x(min)) &&
+           coordinate_in_range<CoordinateType>(transform.x(max)) &&
+           coordinate_in_range<CoordinateType>(transform.y(min)) &&
+           coordinate_in_range<CoordinateType>(transform.y(max));
+}
+
+} // namespace detail
+
+}} // namespace mapbox/vector_tile
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <protozero/data_view.hpp>
+#include <protozero/varint.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define VECTOR_TILE_VARINT_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+// Built for AVX2, no need to check the CPU at runtime
+#define VECTOR_TILE_VARINT_AVX2 1
+#include <immintrin.h>
+#elif !defined(VECTOR_TILE_NO_RUNTIME_DISPATCH)
+#define VECTOR_TILE_VARINT_AVX2 1
+#define VECTOR_TILE_VARINT_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace mapbox { namespace vector_tile { namespace detail {
+
+// Decodes varints one by one, with a shortcut for the single byte values
+// that make up most geometry and tag streams.
+inline std::size_t decode_varints_scalar(const char** data, const char* end, std::uint32_t* out, std::size_t max) {
+    const char* p = *data;
+    std::size_t n = 0;
+    while (n < max && p != end) {
+        const auto byte = static_cast<std::uint8_t>(*p);
+        if (byte < 0x80) {
+            out[n++] = byte;
+            ++p;
+        } else {
+            out[n++] = static_cast<std::uint32_t>(protozero::decode_varint(&p, end));
+        }
+    }
+    *data = p;
+    return n;
+}
+
+#ifdef VECTOR_TILE_VARINT_SSE2
+
+// Widens runs of 16 single byte varints at a time, falling back to the
+// scalar decoder for the first multi byte varint in a block.
+inline std::size_t decode_varints_sse2(const char** data, const char* end, std::uint32_t* out, std::size_t max) {
+    const char* p = *data;
+    std::size_t n = 0;
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16 && max - n >= 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(bytes));
+        if (mask == 0) {
+            const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            __m128i* dst = reinterpret_cast<__m128i*>(out + n);
+            _mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+            p += 16;
+            n += 16;
+        } else {
+            // Copy the single byte values ahead of the first continuation
+            // byte, then decode the multi byte varint it belongs to
+            const auto single = static_cast<std::size_t>(__builtin_ctz(mask));
+            for (std::size_t i = 0; i < single; ++i) {
+                out[n++] = static_cast<std::uint8_t>(p[i]);
+            }
+            p += single;
+            out[n++] = static_cast<std::uint32_t>(protozero::decode_varint(&p, end));
+        }
+    }
+    n += decode_varints_scalar(&p, end, out + n, max - n);
+    *data = p;
+    return n;
+}
+
+#endif
+
+#ifdef VECTOR_TILE_VARINT_AVX2
+
+#ifdef VECTOR_TILE_VARINT_AVX2_DISPATCH
+__attribute__((target("avx2")))
+#endif
+inline std::size_t decode_varints_avx2(const char** data, const char* end, std::uint32_t* out, std::size_t max) {
+    const char* p = *data;
+    std::size_t n = 0;
+    while (end - p >= 32 && max - n >= 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+        if (mask == 0) {
+            for (int i = 0; i < 4; ++i) {
+                const __m128i eight = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 8 * i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n + 8 * static_cast<std::size_t>(i)),
+                                    _mm256_cvtepu8_epi32(eight));
+            }
+            p += 32;
+            n += 32;
+        } else {
+            const auto single = static_cast<std::size_t>(__builtin_ctz(mask));
+            for (std::size_t i = 0; i < single; ++i) {
+                out[n++] = static_cast<std::uint8_t>(p[i]);
+            }
+            p += single;
+            out[n++] = static_cast<std::uint32_t>(protozero::decode_varint(&p, end));
+        }
+    }
+    n += decode_varints_scalar(&p, end, out + n, max - n);
+    *data = p;
+    return n;
+}
+
+inline bool cpu_has_avx2() {
+#ifdef VECTOR_TILE_VARINT_AVX2_DISPATCH
+    static const bool has_avx2 = __builtin_cpu_supports("avx2") != 0;
+    return has_avx2;
+#else
+    return true;
+#endif
+}
+
+#endif
+
+/**
+ * Decode up to `max` varints from [*data, end) into `out`, truncating each
+ * to 32 bits like protozero's packed uint32 iterator. Advances *data past
+ * the decoded bytes and returns the number of values written. Throws
+ * protozero::end_of_buffer_exception on a truncated varint.
+ */
+inline std::size_t decode_varints(const char** data, const char* end, std::uint32_t* out, std::size_t max) {
+#if defined(VECTOR_TILE_VARINT_AVX2)
+    if (cpu_has_avx2()) {
+        return decode_varints_avx2(data, end, out, max);
+    }
+#endif
+#if defined(VECTOR_TILE_VARINT_SSE2)
+    return decode_varints_sse2(data, end, out, max);
+#else
+    return decode_varints_scalar(data, end, out, max);
+#endif
+}
+
+// Number of varints in a packed field
+inline std::size_t count_varints(protozero::data_view const& packed) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < packed.size(); ++i) {
+        count += (static_cast<std::uint8_t>(packed.data()[i]) & 0x80) == 0 ? 1 : 0;
+    }
+    return count;
+}
+
+// Smallest and largest coordinates produced by decode_deltas
+struct coordinate_bounds {
+    std::int32_t min_x = std::numeric_limits<std::int32_t>::max();
+    std::int32_t min_y = std::numeric_limits<std::int32_t>::max();
+    std::int32_t max_x = std::numeric_limits<std::int32_t>::min();
+    std::int32_t max_y = std::numeric_limits<std::int32_t>::min();
+};
+
+inline void decode_deltas_scalar(const std::uint32_t* in, std::size_t count,
+                                 std::int32_t& x, std::int32_t& y,
+                                 std::int32_t* out, coordinate_bounds& bounds) {
+    for (std::size_t i = 0; i < count; ++i) {
+        x += protozero::decode_zigzag32(in[2 * i]);
+        y += protozero::decode_zigzag32(in[2 * i + 1]);
+        out[2 * i] = x;
+        out[2 * i + 1] = y;
+        bounds.min_x = std::min(bounds.min_x, x);
+        bounds.max_x = std::max(bounds.max_x, x);
+        bounds.min_y = std::min(bounds.min_y, y);
+        bounds.max_y = std::max(bounds.max_y, y);
+    }
+}
+
+#ifdef VECTOR_TILE_VARINT_SSE2
+
+// SSE2 has no 32 bit min/max, so select with a compare mask
+inline __m128i min_epi32_sse2(__m128i a, __m128i b) {
+    const __m128i a_greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(a_greater, b), _mm_andnot_si128(a_greater, a));
+}
+
+inline __m128i max_epi32_sse2(__m128i a, __m128i b) {
+    const __m128i a_greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(a_greater, a), _mm_andnot_si128(a_greater, b));
+}
+
+// Two points per register as (x0, y0, x1, y1): zigzag decode, add the
+// first delta pair onto the second, then add the running position.
+inline void decode_deltas_sse2(const std::uint32_t* in, std::size_t count,
+                               std::int32_t& x, std::int32_t& y,
+                               std::int32_t* out, coordinate_bounds& bounds) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i position = _mm_set_epi32(y, x, y, x);
+    __m128i lowest = _mm_set_epi32(bounds.min_y, bounds.min_x, bounds.min_y, bounds.min_x);
+    __m128i highest = _mm_set_epi32(bounds.max_y, bounds.max_x, bounds.max_y, bounds.max_x);
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128i zigzag = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+        __m128i delta = _mm_xor_si128(_mm_srli_epi32(zigzag, 1),
+                                      _mm_sub_epi32(zero, _mm_and_si128(zigzag, one)));
+        delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+        const __m128i points = _mm_add_epi32(delta, position);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), points);
+        lowest = min_epi32_sse2(lowest, points);
+        highest = max_epi32_sse2(highest, points);
+        position = _mm_shuffle_epi32(points, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    x = _mm_cvtsi128_si32(position);
+    y = _mm_cvtsi128_si32(_mm_srli_si128(position, 4));
+    lowest = min_epi32_sse2(lowest, _mm_shuffle_epi32(lowest, _MM_SHUFFLE(1, 0, 3, 2)));
+    highest = max_epi32_sse2(highest, _mm_shuffle_epi32(highest, _MM_SHUFFLE(1, 0, 3, 2)));
+    bounds.min_x = _mm_cvtsi128_si32(lowest);
+    bounds.min_y = _mm_cvtsi128_si32(_mm_srli_si128(lowest, 4));
+    bounds.max_x = _mm_cvtsi128_si32(highest);
+    bounds.max_y = _mm_cvtsi128_si32(_mm_srli_si128(highest, 4));
+    decode_deltas_scalar(in + 2 * i, count - i, x, y, out + 2 * i, bounds);
+}
+
+#endif
+
+/**
+ * Decode `count` zigzag encoded (dx, dy) pairs from `in`, accumulating
+ * onto (x, y) and writing the absolute coordinates interleaved to `out`.
+ * `bounds` is widened to cover them. Returns false, without touching
+ * anything, when the run could leave the 32 bit range; the caller must
+ * then decode it with 64 bit, checked arithmetic.
+ */
+inline bool decode_deltas(const std::uint32_t* in, std::size_t count,
+                          std::int64_t& x, std::int64_t& y,
+                          std::int32_t* out, coordinate_bounds& bounds) {
+    std::uint32_t any_bits = 0;
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+        any_bits |= in[i];
+    }
+    // A zigzag value below 2^k decodes to a magnitude of at most 2^(k-1)
+    const std::int64_t max_delta = static_cast<std::int64_t>(any_bits >> 1) + 1;
+    const std::int64_t reach = static_cast<std::int64_t>(count) * max_delta;
+    const std::int64_t limit = std::numeric_limits<std::int32_t>::max();
+    if (std::abs(x) + reach >= limit || std::abs(y) + reach >= limit) {
+        return false;
+    }
+    auto x32 = static_cast<std::int32_t>(x);
+    auto y32 = static_cast<std::int32_t>(y);
+#ifdef VECTOR_TILE_VARINT_SSE2
+    decode_deltas_sse2(in, count, x32, y32, out, bounds);
+#else
+    decode_deltas_scalar(in, count, x32, y32, out, bounds);
+#endif
+    x = x32;
+    y = y32;
+    return true;
+}
+
+/**
+ * Reads a packed uint32 field through a fixed block on the stack that is
+ * refilled with decode_varints as it drains, so the hot loops consuming it
+ * work on plain arrays without allocating.
+ */
+class packed_uint32_reader {
+public:
+    static constexpr std::size_t block_size = 128;
+
+    explicit packed_uint32_reader(protozero::data_view const& packed)
+        : data_(packed.data()),
+          end_(packed.data() + packed.size()) {}
+
+    bool empty() const { return pos_ == size_ && data_ == end_; }
+
+    std::uint32_t next() {
+        if (pos_ == size_) {
+            refill();
+        }
+        return block_[pos_++];
+    }
+
+    // Decoded values ready to be consumed from data(), refilling if none are
+    std::size_t available() {
+        if (pos_ == size_ && data_ != end_) {
+            refill();
+        }
+        return size_ - pos_;
+    }
+
+    const std::uint32_t* data() const { return block_ + pos_; }
+
+    void advance(std::size_t n) { pos_ += n; }
+
+private:
+    void refill() {
+        if (data_ == end_) {
+            throw protozero::end_of_buffer_exception();
+        }
+        pos_ = 0;
+        size_ = decode_varints(&data_, end_, block_, block_size);
+    }
+
+    const char* data_;
+    const char* end_;
+    std::size_t pos_ = 0;
+    std::size_t size_ = 0;
+    std::uint32_t block_[block_size];
+};
+
+}}} // namespace mapbox/vector_tile/detail
@@ -0,0 +1,103 @@
+#include <mapbox/vector_tile/varint.hpp>
+
+#include <catch.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string encode_varints(std::vector<std::uint32_t> const& values) {
+    std::string data;
+    for (auto value : values) {
+        while (value >= 0x80) {
+            data += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        data += static_cast<char>(value);
+    }
+    return data;
+}
+
+TEST_CASE( "Block varint decoding matches one at a time decoding" ) {
+    std::mt19937 gen(42);
+    std::vector<std::uint32_t> values;
+    for (std::size_t run = 0; run < 200; ++run) {
+        // long runs of single byte values with the odd wide one in between
+        std::uniform_int_distribution<std::uint32_t> small(0, 127);
+        std::uniform_int_distribution<std::size_t> run_length(0, 70);
+        for (std::size_t i = run_length(gen); i > 0; --i) {
+            values.push_back(small(gen));
+        }
+        std::uniform_int_distribution<std::uint32_t> wide(128, 0xffffffff);
+        values.push_back(wide(gen));
+    }
+    std::string const data = encode_varints(values);
+    REQUIRE(mapbox::vector_tile::detail::count_varints(data) == values.size());
+
+    std::vector<std::uint32_t> decoded(values.size());
+    const char* begin = data.data();
+    auto n = mapbox::vector_tile::detail::decode_varints(&begin, data.data() + data.size(), decoded.data(), decoded.size());
+    REQUIRE(n == values.size());
+    REQUIRE(begin == data.data() + data.size());
+    REQUIRE(decoded == values);
+
+    mapbox::vector_tile::detail::packed_uint32_reader reader(data);
+    std::vector<std::uint32_t> streamed;
+    while (!reader.empty()) {
+        streamed.push_back(reader.next());
+    }
+    REQUIRE(streamed == values);
+    REQUIRE_THROWS_AS(reader.next(), protozero::end_of_buffer_exception const&);
+
+    std::string const truncated = data.substr(0, data.size() - 1);
+    mapbox::vector_tile::detail::packed_uint32_reader truncated_reader(truncated);
+    auto drain = [&truncated_reader]() {
+        while (!truncated_reader.empty()) {
+            truncated_reader.next();
+        }
+    };
+    REQUIRE_THROWS_AS(drain(), protozero::end_of_buffer_exception const&);
+}
+
+TEST_CASE( "Delta decoding of coordinate runs" ) {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<std::int32_t> delta(-5000, 5000);
+    std::vector<std::uint32_t> zigzag;
+    std::vector<std::int32_t> expected;
+    std::int64_t ex = 100;
+    std::int64_t ey = -100;
+    for (std::size_t i = 0; i < 63; ++i) {
+        auto const dx = delta(gen);
+        auto const dy = delta(gen);
+        zigzag.push_back(protozero::encode_zigzag32(dx));
+        zigzag.push_back(protozero::encode_zigzag32(dy));
+        ex += dx;
+        ey += dy;
+        expected.push_back(static_cast<std::int32_t>(ex));
+        expected.push_back(static_cast<std::int32_t>(ey));
+    }
+
+    std::int64_t x = 100;
+    std::int64_t y = -100;
+    std::vector<std::int32_t> out(expected.size());
+    mapbox::vector_tile::detail::coordinate_bounds bounds;
+    REQUIRE(mapbox::vector_tile::detail::decode_deltas(zigzag.data(), 63, x, y, out.data(), bounds));
+    REQUIRE(out == expected);
+    REQUIRE(x == ex);
+    REQUIRE(y == ey);
+    std::int32_t min_x = expected[0];
+    std::int32_t max_y = expected[1];
+    for (std::size_t i = 0; i < expected.size(); i += 2) {
+        min_x = std::min(min_x, expected[i]);
+        max_y = std::max(max_y, expected[i + 1]);
+    }
+    REQUIRE(bounds.min_x == min_x);
+    REQUIRE(bounds.max_y == max_y);
+
+    // Runs that might leave the 32 bit range are left to the caller
+    std::vector<std::uint32_t> const huge = {protozero::encode_zigzag32(std::numeric_limits<std::int32_t>::max()), 0,
+                                             protozero::encode_zigzag32(std::numeric_limits<std::int32_t>::max()), 0};
+    x = 0;
+    REQUIRE_FALSE(mapbox::vector_tile::detail::decode_deltas(huge.data(), 2, x, y, out.data(), bounds));
+    REQUIRE(x == 0);
+}
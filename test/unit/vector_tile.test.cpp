@@ -1,8 +1,12 @@
 #include <mapbox/vector_tile.hpp>
 #include <mapbox/vector_tile/version.hpp>
+#include <mapbox/vector_tile/mapped_file.hpp>
+#include <mapbox/vector_tile/overzoom.hpp>
+#include <protozero/pbf_writer.hpp>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <random>
 
 #include <catch.hpp>
 
@@ -17,6 +21,79 @@ static std::string open_tile(std::string const& path) {
     return message;
 }
 
+// Minimal tile writer for cases the fixtures do not cover
+struct test_layer {
+    std::string name = "layer_name";
+    std::uint32_t extent = 4096;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;   // encoded Value messages
+    std::vector<std::string> features; // encoded Feature messages
+    bool name_last = false;
+};
+
+static std::string string_value(std::string const& str) {
+    std::string data;
+    protozero::pbf_writer value(data);
+    value.add_string(mapbox::vector_tile::ValueType::STRING, str);
+    return data;
+}
+
+static std::string int_value(std::int64_t number) {
+    std::string data;
+    protozero::pbf_writer value(data);
+    value.add_int64(mapbox::vector_tile::ValueType::INT, number);
+    return data;
+}
+
+static std::uint32_t command(std::uint32_t cmd, std::uint32_t count) {
+    return (count << 3) | cmd;
+}
+
+static std::uint32_t zigzag(std::int32_t delta) {
+    return protozero::encode_zigzag32(delta);
+}
+
+static std::string encode_feature(mapbox::vector_tile::GeomType type,
+                                  std::vector<std::uint32_t> const& tags,
+                                  std::vector<std::uint32_t> const& geometry,
+                                  std::uint64_t id = 0) {
+    std::string data;
+    protozero::pbf_writer feature(data);
+    if (id != 0) {
+        feature.add_uint64(mapbox::vector_tile::FeatureType::ID, id);
+    }
+    feature.add_packed_uint32(mapbox::vector_tile::FeatureType::TAGS, tags.begin(), tags.end());
+    feature.add_enum(mapbox::vector_tile::FeatureType::TYPE, type);
+    feature.add_packed_uint32(mapbox::vector_tile::FeatureType::GEOMETRY, geometry.begin(), geometry.end());
+    return data;
+}
+
+static std::string encode_tile(std::vector<test_layer> const& layers) {
+    std::string data;
+    protozero::pbf_writer tile(data);
+    for (auto const& l : layers) {
+        protozero::pbf_writer layer(tile, mapbox::vector_tile::TileType::LAYERS);
+        layer.add_uint32(mapbox::vector_tile::LayerType::VERSION, 2);
+        if (!l.name_last) {
+            layer.add_string(mapbox::vector_tile::LayerType::NAME, l.name);
+        }
+        for (auto const& f : l.features) {
+            layer.add_message(mapbox::vector_tile::LayerType::FEATURES, f);
+        }
+        for (auto const& k : l.keys) {
+            layer.add_string(mapbox::vector_tile::LayerType::KEYS, k);
+        }
+        for (auto const& v : l.values) {
+            layer.add_message(mapbox::vector_tile::LayerType::VALUES, v);
+        }
+        layer.add_uint32(mapbox::vector_tile::LayerType::EXTENT, l.extent);
+        if (l.name_last) {
+            layer.add_string(mapbox::vector_tile::LayerType::NAME, l.name);
+        }
+    }
+    return data;
+}
+
 #define ASSERT_KNOWN_FEATURE() \
     auto const layer_names = tile.layerNames(); \
     REQUIRE(layer_names.size() == 1); \
@@ -153,4 +230,1190 @@ TEST_CASE( "Allow multiple keys mapping to different tag ids" ) {
     REQUIRE(error.empty());
     REQUIRE(val1.is<std::string>());
     REQUIRE(val1.get<std::string>() == "single_value");
-}
\ No newline at end of file
+}
+
+TEST_CASE( "Decode without copying the tile into a string" ) {
+    mapbox::vector_tile::mapped_file file("test/test2048.mvt");
+    std::string const buffer = open_tile("test/test2048.mvt");
+    REQUIRE(file.size() == buffer.size());
+
+    mapbox::vector_tile::buffer mapped_tile(file.view());
+    auto const layer = mapped_tile.getLayer("roads");
+    REQUIRE(layer.featureCount() == 243);
+
+    mapbox::vector_tile::buffer raw_tile(buffer.data(), buffer.size());
+    REQUIRE(raw_tile.layerNames() == mapped_tile.layerNames());
+
+    REQUIRE_THROWS(mapbox::vector_tile::mapped_file("test/does-not-exist.mvt"));
+}
+
+TEST_CASE( "Layers are indexed in tile order without copying names" ) {
+    std::string buffer = open_tile("test/test2048.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    REQUIRE(tile.layerCount() == 1);
+    auto const& layers = tile.getLayers();
+    REQUIRE(layers.size() == 1);
+    REQUIRE(layers[0].first.to_string() == "roads");
+    // names and layers point into the tile bytes
+    REQUIRE(layers[0].first.data() >= buffer.data());
+    REQUIRE(layers[0].first.data() < buffer.data() + buffer.size());
+    REQUIRE(mapbox::vector_tile::layer(layers[0].second).featureCount() == 243);
+    REQUIRE_THROWS(tile.getLayer("road"));
+}
+
+TEST_CASE( "Layers are opened with a single walk over their fields" ) {
+    using namespace mapbox::vector_tile;
+    test_layer first;
+    first.name = "first";
+    first.keys = {"kind"};
+    first.values = {string_value("park")};
+    first.features = {encode_feature(GeomType::POINT, {0, 0}, {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(2)})};
+    test_layer second = first;
+    second.name = "second";
+    second.name_last = true;
+    std::string const data = encode_tile({first, second});
+
+    buffer tile(data);
+    REQUIRE(tile.layerNames() == std::vector<std::string>({"first", "second"}));
+    auto const l = tile.getLayer("second");
+    REQUIRE(l.getName() == "second");
+    REQUIRE(l.featureCount() == 1);
+    REQUIRE(l.getExtent() == 4096);
+    REQUIRE(l.getVersion() == 2);
+
+    auto const& fields = tile.getLayerFields();
+    REQUIRE(fields.size() == 2);
+    CHECK(fields[1].name.to_string() == "second");
+    CHECK(fields[1].keys.size() == 1);
+    CHECK(fields[1].values.size() == 1);
+    CHECK(fields[1].features.size() == 1);
+    CHECK(fields[1].extent == 4096);
+
+    // With repeated NAME fields the last one names the layer, in the index
+    // and in the layer alike
+    std::string renamed;
+    {
+        protozero::pbf_writer tile_writer(renamed);
+        protozero::pbf_writer layer_writer(tile_writer, TileType::LAYERS);
+        layer_writer.add_string(LayerType::NAME, "old");
+        layer_writer.add_uint32(LayerType::VERSION, 2);
+        layer_writer.add_uint32(LayerType::EXTENT, 4096);
+        layer_writer.add_string(LayerType::NAME, "new");
+    }
+    buffer const renamed_tile(renamed);
+    REQUIRE(renamed_tile.layerNames() == std::vector<std::string>({"new"}));
+    CHECK(renamed_tile.getLayer("new").getName() == "new");
+    CHECK(layer(renamed_tile.getLayers()[0].second).getName() == "new");
+
+    std::string missing_name;
+    protozero::pbf_writer writer(missing_name);
+    {
+        protozero::pbf_writer layer_writer(writer, TileType::LAYERS);
+        layer_writer.add_uint32(LayerType::EXTENT, 4096);
+    }
+    REQUIRE_THROWS_WITH(buffer(missing_name.data(), missing_name.size()), "Layer missing name");
+}
+
+TEST_CASE( "Key lookup over many keys including duplicates" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    std::vector<std::uint32_t> tags;
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        l.keys.push_back("key" + std::to_string(i));
+        l.values.push_back(string_value("value" + std::to_string(i)));
+        tags.push_back(i);
+        tags.push_back(i);
+    }
+    // a second "key7" that the feature references instead of the first one
+    l.keys.push_back("key7");
+    l.values.push_back(string_value("duplicate"));
+    tags[14] = 100;
+    tags[15] = 100;
+    l.features = {encode_feature(GeomType::POINT, tags, {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1)})};
+    std::string const data = encode_tile({l});
+
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    feature const f(lyr.getFeature(0), lyr);
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        if (i == 7) {
+            continue;
+        }
+        std::string warning;
+        auto const val = f.getValue("key" + std::to_string(i), &warning);
+        REQUIRE(warning.empty());
+        REQUIRE(val.get<std::string>() == "value" + std::to_string(i));
+    }
+    std::string warning;
+    REQUIRE(f.getValue("key7", &warning).get<std::string>() == "duplicate");
+    REQUIRE(warning == "duplicate keys with different tag ids are found");
+    REQUIRE(f.getValue("key100").is<mapbox::feature::null_value_t>());
+    REQUIRE(f.getProperties().size() == 100);
+}
+
+TEST_CASE( "Key lookup with one key repeated many times" ) {
+    using namespace mapbox::vector_tile;
+    // Every copy of "dup" used to take its own slot in one probe cluster,
+    // making layer construction quadratic in the number of copies
+    constexpr std::uint32_t copies = 100000;
+    test_layer l;
+    l.keys.assign(copies, "dup");
+    l.keys.push_back("other");
+    l.values = {string_value("a"), string_value("b")};
+    l.features = {encode_feature(GeomType::POINT, {copies - 1, 0, copies, 1}, {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1)})};
+    std::string const data = encode_tile({l});
+
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    feature const f(lyr.getFeature(0), lyr);
+    std::string warning;
+    REQUIRE(f.getValue("dup", &warning).get<std::string>() == "a");
+    REQUIRE(warning == "duplicate keys with different tag ids are found");
+    REQUIRE(f.getValue("other").get<std::string>() == "b");
+    REQUIRE(f.getValue("missing").is<mapbox::feature::null_value_t>());
+
+    auto const keys = lyr.resolveKeys({"other", "dup"});
+    std::vector<value_view> values;
+    f.getValues(keys, values);
+    REQUIRE(values[0].get<protozero::data_view>().to_string() == "b");
+    REQUIRE(values[1].get<protozero::data_view>().to_string() == "a");
+}
+
+TEST_CASE( "Features share the decoded values of their layer" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.keys = {"class", "rank"};
+    // The third value claims a five byte string but holds two
+    l.values = {string_value("street"), int_value(-3), std::string("\x0a\x05" "ab")};
+    std::vector<std::uint32_t> const point = {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1)};
+    l.features = {encode_feature(GeomType::POINT, {0, 0, 1, 1}, point),
+                  encode_feature(GeomType::POINT, {1, 1, 0, 0}, point),
+                  encode_feature(GeomType::POINT, {0, 3}, point),
+                  encode_feature(GeomType::POINT, {0, 0, 1, 2}, point)};
+    std::string const data = encode_tile({l});
+
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    for (std::size_t i = 0; i < 2; ++i) {
+        feature const f(lyr.getFeature(i), lyr);
+        REQUIRE(f.getValue("class").get<std::string>() == "street");
+        REQUIRE(f.getValue("rank").get<std::int64_t>() == -3);
+        auto const props = f.getProperties();
+        REQUIRE(props.at("class").get<std::string>() == "street");
+        REQUIRE(props.at("rank").get<std::int64_t>() == -3);
+    }
+    feature const broken(lyr.getFeature(2), lyr);
+    REQUIRE_THROWS_WITH(broken.getValue("class"), "feature referenced out of range value");
+    REQUIRE_THROWS(broken.getProperties());
+    // A value that fails to decode only throws once a feature reads it
+    feature const malformed(lyr.getFeature(3), lyr);
+    REQUIRE(malformed.getValue("class").get<std::string>() == "street");
+    REQUIRE_THROWS_AS(malformed.getValue("rank"), protozero::end_of_buffer_exception const&);
+}
+
+TEST_CASE( "Iterate properties without materializing them" ) {
+    std::string buffer = open_tile("test/duplicate-keys-values.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    auto const layer = tile.getLayer("duplicates");
+    auto const feature = mapbox::vector_tile::feature(layer.getFeature(0), layer);
+    std::vector<std::string> seen;
+    feature.forEachProperty([&](protozero::data_view const& key, mapbox::vector_tile::value_view const& value) {
+        REQUIRE(key.data() >= buffer.data());
+        REQUIRE(key.data() < buffer.data() + buffer.size());
+        REQUIRE(value.is<protozero::data_view>());
+        seen.push_back(key.to_string() + "=" + value.get<protozero::data_view>().to_string());
+    });
+    REQUIRE(seen == std::vector<std::string>({"hello=world", "hello=world", "unique=single_value"}));
+}
+
+TEST_CASE( "Look up values without copying strings out of the tile" ) {
+    std::string buffer = open_tile("test/duplicate-keys-values.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    auto const layer = tile.getLayer("duplicates");
+    auto const feature = mapbox::vector_tile::feature(layer.getFeature(0), layer);
+
+    auto const view = feature.getValueView("unique");
+    REQUIRE(view.is<protozero::data_view>());
+    auto const& str = view.get<protozero::data_view>();
+    REQUIRE(str.data() >= buffer.data());
+    REQUIRE(str.data() < buffer.data() + buffer.size());
+    REQUIRE(str.to_string() == "single_value");
+
+    auto const value = mapbox::vector_tile::toValue(view);
+    REQUIRE(value.is<std::string>());
+    REQUIRE(value.get<std::string>() == "single_value");
+
+    std::string warning;
+    REQUIRE(feature.getValueView("hello", &warning).is<protozero::data_view>());
+    REQUIRE(warning == "duplicate keys with different tag ids are found");
+    REQUIRE(feature.getValueView("missing").is<mapbox::feature::null_value_t>());
+    REQUIRE(mapbox::vector_tile::toValue(mapbox::vector_tile::value_view(true)).get<bool>());
+}
+
+TEST_CASE( "Read several values in one pass over the tags" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.keys = {"name", "class", "rank", "name"};
+    // The last value is empty, which decodes to null
+    l.values = {string_value("Main St"), string_value("street"), int_value(4), string_value("Other"), std::string()};
+    std::vector<std::uint32_t> const point = {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1)};
+    l.features = {encode_feature(GeomType::POINT, {1, 1, 3, 0, 2, 2}, point),
+                  encode_feature(GeomType::POINT, {1, 1}, point),
+                  encode_feature(GeomType::POINT, {1, 4, 1, 1, 0, 0, 2, 2}, point)};
+    std::string const data = encode_tile({l});
+
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    auto const keys = lyr.resolveKeys({"rank", "name", "ref", "class", "rank"});
+    REQUIRE(keys.size() == 5);
+
+    std::vector<value_view> values;
+    feature(lyr.getFeature(0), lyr).getValues(keys, values);
+    REQUIRE(values.size() == 5);
+    REQUIRE(values[0].get<std::int64_t>() == 4);
+    REQUIRE(values[1].get<protozero::data_view>().to_string() == "Main St");
+    REQUIRE(values[2].is<mapbox::feature::null_value_t>());
+    REQUIRE(values[3].get<protozero::data_view>().to_string() == "street");
+    REQUIRE(values[4].get<std::int64_t>() == 4);
+
+    feature(lyr.getFeature(1), lyr).getValues(keys, values);
+    REQUIRE(values.size() == 5);
+    REQUIRE(values[0].is<mapbox::feature::null_value_t>());
+    REQUIRE(values[1].is<mapbox::feature::null_value_t>());
+    REQUIRE(values[3].get<protozero::data_view>().to_string() == "street");
+
+    // A first tag holding null still wins, and does not count twice
+    feature(lyr.getFeature(2), lyr).getValues(keys, values);
+    REQUIRE(values[0].get<std::int64_t>() == 4);
+    REQUIRE(values[1].get<protozero::data_view>().to_string() == "Main St");
+    REQUIRE(values[3].is<mapbox::feature::null_value_t>());
+
+    // More keys than fit in a word of bits
+    std::vector<std::string> many(100, "unknown");
+    many[70] = "class";
+    many[90] = "rank";
+    feature(lyr.getFeature(2), lyr).getValues(lyr.resolveKeys(many), values);
+    REQUIRE(values.size() == 100);
+    REQUIRE(values[70].is<mapbox::feature::null_value_t>());
+    REQUIRE(values[90].get<std::int64_t>() == 4);
+}
+
+TEST_CASE( "Look up values through resolved key handles" ) {
+    std::string buffer = open_tile("test/duplicate-keys-values.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    auto const layer = tile.getLayer("duplicates");
+    auto const hello = layer.resolveKey("hello");
+    auto const unique = layer.resolveKey("unique");
+    auto const missing = layer.resolveKey("missing");
+    REQUIRE(!hello.empty());
+    REQUIRE(missing.empty());
+
+    auto const feature = mapbox::vector_tile::feature(layer.getFeature(0), layer);
+    std::string warning;
+    REQUIRE(feature.getValue(hello, &warning).get<std::string>() == "world");
+    REQUIRE(warning == "duplicate keys with different tag ids are found");
+    warning.clear();
+    REQUIRE(feature.getValueView(unique, &warning).get<protozero::data_view>().to_string() == "single_value");
+    REQUIRE(warning.empty());
+    REQUIRE(feature.getValue(missing).is<mapbox::feature::null_value_t>());
+}
+
+struct recording_sink {
+    std::stringstream s;
+    void move_to(std::int32_t x, std::int32_t y) { s << "M" << x << "," << y << " "; }
+    void line_to(std::int32_t x, std::int32_t y) { s << "L" << x << "," << y << " "; }
+    void close() { s << "Z "; }
+};
+
+TEST_CASE( "Stream geometry commands to a sink" ) {
+    std::string buffer = open_tile("test/mvt-fixtures/fixtures/valid/Feature-single-polygon.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    auto const layer = tile.getLayer("layer_name");
+    auto const feature = mapbox::vector_tile::feature(layer.getFeature(0), layer);
+    recording_sink sink;
+    feature.decodeGeometry(sink);
+    REQUIRE(sink.s.str() == "M3,6 L8,12 L20,34 Z ");
+
+    std::string roads = open_tile("test/test2048.mvt");
+    mapbox::vector_tile::buffer roads_tile(roads);
+    auto const roads_layer = roads_tile.getLayer("roads");
+    for (std::size_t i = 0; i < roads_layer.featureCount(); ++i) {
+        auto const road = mapbox::vector_tile::feature(roads_layer.getFeature(i), roads_layer);
+        auto const geom = road.getGeometries<mapbox::vector_tile::points_arrays_type>(1.0);
+        recording_sink expected;
+        for (auto const& line : geom) {
+            for (std::size_t j = 0; j < line.size(); ++j) {
+                if (j == 0) {
+                    expected.move_to(line[j].x, line[j].y);
+                } else {
+                    expected.line_to(line[j].x, line[j].y);
+                }
+            }
+        }
+        recording_sink decoded;
+        road.decodeGeometry(decoded);
+        REQUIRE(decoded.s.str() == expected.s.str());
+    }
+}
+
+TEST_CASE( "Decode geometries into reusable flat arrays" ) {
+    std::string buffer = open_tile("test/mvt-fixtures/fixtures/valid/Feature-single-multilinestring.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    auto const layer = tile.getLayer("layer_name");
+    auto const feature = mapbox::vector_tile::feature(layer.getFeature(0), layer);
+    mapbox::vector_tile::geometry_buffer geom;
+    feature.decodeGeometry(geom);
+    REQUIRE(geom.ringCount() == 2);
+    REQUIRE(geom.pointCount() == 5);
+    REQUIRE(geom.ringBegin(1) == 3);
+    REQUIRE(geom.ringEnd(1) == 5);
+    REQUIRE(geom.x == std::vector<std::int32_t>({2, 2, 10, 1, 3}));
+    REQUIRE(geom.y == std::vector<std::int32_t>({2, 10, 10, 1, 5}));
+
+    // closing repeats the first point, and clearing keeps the storage
+    std::string polygon = open_tile("test/mvt-fixtures/fixtures/valid/Feature-single-polygon.mvt");
+    mapbox::vector_tile::buffer polygon_tile(polygon);
+    auto const polygon_layer = polygon_tile.getLayer("layer_name");
+    auto const capacity = geom.x.capacity();
+    geom.clear();
+    mapbox::vector_tile::feature(polygon_layer.getFeature(0), polygon_layer).decodeGeometry(geom);
+    REQUIRE(geom.x.capacity() == capacity);
+    REQUIRE(geom.ringCount() == 1);
+    REQUIRE(geom.x == std::vector<std::int32_t>({3, 8, 20, 3}));
+    REQUIRE(geom.y == std::vector<std::int32_t>({6, 12, 34, 6}));
+}
+
+TEST_CASE( "Decode the geometry of a whole layer at once" ) {
+    std::string buffer = open_tile("test/test2048.mvt");
+    mapbox::vector_tile::buffer tile(buffer);
+    auto const layer = tile.getLayer("roads");
+    mapbox::vector_tile::layer_geometry_buffer arena;
+    layer.decodeGeometries(arena);
+    REQUIRE(arena.featureCount() == layer.featureCount());
+    for (std::size_t i = 0; i < layer.featureCount(); ++i) {
+        auto const feature = mapbox::vector_tile::feature(layer.getFeature(i), layer);
+        REQUIRE(arena.types[i] == feature.getType());
+        mapbox::vector_tile::geometry_buffer expected;
+        feature.decodeGeometry(expected);
+        REQUIRE(arena.featureRingEnd(i) - arena.featureRingBegin(i) == expected.ringCount());
+        for (std::size_t r = 0; r < expected.ringCount(); ++r) {
+            auto const ring = arena.featureRingBegin(i) + r;
+            REQUIRE(arena.geometry.ringEnd(ring) - arena.geometry.ringBegin(ring) == expected.ringEnd(r) - expected.ringBegin(r));
+            REQUIRE(arena.geometry.x[arena.geometry.ringBegin(ring)] == expected.x[expected.ringBegin(r)]);
+            REQUIRE(arena.geometry.y[arena.geometry.ringEnd(ring) - 1] == expected.y[expected.ringEnd(r) - 1]);
+        }
+    }
+    auto const points = arena.geometry.pointCount();
+    layer.decodeGeometries(arena);
+    REQUIRE(arena.geometry.pointCount() == points);
+}
+
+TEST_CASE( "Long linestrings decode the same through every path" ) {
+    using namespace mapbox::vector_tile;
+    std::vector<std::uint32_t> geometry = {command(CommandType::MOVE_TO, 1), zigzag(10), zigzag(20),
+                                           command(CommandType::LINE_TO, 1000)};
+    std::vector<std::int32_t> xs = {10};
+    std::vector<std::int32_t> ys = {20};
+    for (std::int32_t i = 0; i < 1000; ++i) {
+        std::int32_t const dx = (i % 7) - 3;
+        std::int32_t const dy = (i % 2 == 0) ? 2 : -1;
+        geometry.push_back(zigzag(dx));
+        geometry.push_back(zigzag(dy));
+        xs.push_back(xs.back() + dx);
+        ys.push_back(ys.back() + dy);
+    }
+    test_layer l;
+    l.features = {encode_feature(GeomType::LINESTRING, {}, geometry)};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    feature const f(lyr.getFeature(0), lyr);
+
+    auto const paths = f.getGeometries<points_arrays_type>(1.0);
+    REQUIRE(paths.size() == 1);
+    REQUIRE(paths[0].size() == xs.size());
+    geometry_buffer flat;
+    f.decodeGeometry(flat);
+    REQUIRE(flat.x == xs);
+    REQUIRE(flat.y == ys);
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+        REQUIRE(paths[0][i].x == xs[i]);
+        REQUIRE(paths[0][i].y == ys[i]);
+    }
+
+    auto const doubled = f.getGeometries<points_arrays_type>(2.0);
+    REQUIRE(doubled[0].back().x == xs.back() * 2);
+    // y climbs to 520, and 52000 does not fit the int16 coordinates of points_arrays_type
+    REQUIRE_THROWS_WITH(f.getGeometries<points_arrays_type>(100.0), "paths outside valid range of coordinate_type");
+}
+
+TEST_CASE( "Transform coordinates while decoding geometries" ) {
+    using namespace mapbox::vector_tile;
+    // (4,-6) -> (5,-3) -> (15,-3) -> (16,-4)
+    std::vector<std::uint32_t> const geometry = {command(CommandType::MOVE_TO, 1), zigzag(4), zigzag(-6),
+                                                 command(CommandType::LINE_TO, 3), zigzag(1), zigzag(3),
+                                                 zigzag(10), zigzag(0), zigzag(1), zigzag(-1)};
+    test_layer l;
+    l.features = {encode_feature(GeomType::LINESTRING, {}, geometry)};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    feature const f(lyr.getFeature(0), lyr);
+
+    using int_lines = mapbox::geometry::multi_line_string<std::int32_t>;
+    using double_lines = mapbox::geometry::multi_line_string<double>;
+    auto const xs = [](int_lines const& lines) {
+        std::vector<std::int32_t> out;
+        for (auto const& p : lines.at(0)) out.push_back(p.x);
+        return out;
+    };
+    auto const ys = [](int_lines const& lines) {
+        std::vector<std::int32_t> out;
+        for (auto const& p : lines.at(0)) out.push_back(p.y);
+        return out;
+    };
+
+    auto const identity = f.getGeometries<int_lines>(identity_transform());
+    REQUIRE(xs(identity) == std::vector<std::int32_t>({4, 5, 15, 16}));
+    REQUIRE(ys(identity) == std::vector<std::int32_t>({-6, -3, -3, -4}));
+
+    auto const up = f.getGeometries<int_lines>(shift_transform(2));
+    REQUIRE(xs(up) == std::vector<std::int32_t>({16, 20, 60, 64}));
+
+    // halves round away from zero, like the float scale
+    auto const down = f.getGeometries<int_lines>(shift_transform(-1));
+    REQUIRE(xs(down) == std::vector<std::int32_t>({2, 3, 8, 8}));
+    REQUIRE(ys(down) == std::vector<std::int32_t>({-3, -2, -2, -2}));
+    auto const scaled = f.getGeometries<int_lines>(0.5f);
+    REQUIRE(xs(scaled) == xs(down));
+    REQUIRE(ys(scaled) == ys(down));
+
+    // Power of two scales take the integer transforms and match roundf
+    for (float const scale : {1.0f, 2.0f, 0.5f, 0.25f, 1024.0f, 0.3f, 3.0f, -2.0f}) {
+        CHECK(f.getGeometries<int_lines>(scale) == f.getGeometries<int_lines>(scale_transform(scale)));
+    }
+    int shift = 0;
+    CHECK(detail::power_of_two_shift(0.125f, shift));
+    CHECK(shift == -3);
+    CHECK_FALSE(detail::power_of_two_shift(0.0f, shift));
+    CHECK_FALSE(detail::power_of_two_shift(-4.0f, shift));
+    CHECK_FALSE(detail::power_of_two_shift(std::numeric_limits<float>::infinity(), shift));
+    CHECK_FALSE(detail::power_of_two_shift(std::ldexp(1.0f, 40), shift));
+
+    auto const fixed = f.getGeometries<int_lines>(fixed_point_transform(1.5));
+    REQUIRE(xs(fixed) == std::vector<std::int32_t>({6, 8, 23, 24}));
+    REQUIRE(ys(fixed) == std::vector<std::int32_t>({-9, -5, -5, -6}));
+
+    auto const flipped = f.getGeometries<int_lines>(y_flip_transform(4096));
+    REQUIRE(xs(flipped) == xs(identity));
+    REQUIRE(ys(flipped) == std::vector<std::int32_t>({4102, 4099, 4099, 4100}));
+
+    auto const affine = f.getGeometries<double_lines>(affine_transform(0.25, 100.0, -0.5));
+    REQUIRE(affine.at(0).size() == 4);
+    CHECK(affine[0][0].x == Approx(101.0));
+    CHECK(affine[0][0].y == Approx(-2.0));
+    CHECK(affine[0][2].x == Approx(104.0));
+    CHECK(affine[0][2].y == Approx(-1.0));
+
+    // 16 << 12 does not fit the int16 coordinates of points_arrays_type
+    REQUIRE_THROWS_WITH(f.getGeometries<points_arrays_type>(shift_transform(12)), "paths outside valid range of coordinate_type");
+}
+
+TEST_CASE( "Geometries are range checked unless the transform proves they fit" ) {
+    using namespace mapbox::vector_tile;
+    // Swings of 30000 back and forth, which stay inside int16
+    std::vector<std::uint32_t> geometry = {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                           command(CommandType::LINE_TO, 4)};
+    for (std::int32_t i = 0; i < 4; ++i) {
+        geometry.push_back(zigzag(i % 2 == 0 ? 30000 : -30000));
+        geometry.push_back(zigzag(1));
+    }
+    // Points whose running sum leaves int32
+    std::vector<std::uint32_t> const far = {command(CommandType::MOVE_TO, 3),
+                                            zigzag(std::numeric_limits<std::int32_t>::max()), zigzag(0),
+                                            zigzag(std::numeric_limits<std::int32_t>::max()), zigzag(0),
+                                            zigzag(std::numeric_limits<std::int32_t>::max()), zigzag(0)};
+    test_layer l;
+    l.features = {encode_feature(GeomType::LINESTRING, {}, geometry),
+                  encode_feature(GeomType::POINT, {}, far)};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    feature const f(lyr.getFeature(0), lyr);
+
+    CHECK_FALSE(detail::transform_in_range<std::int16_t>(identity_transform()));
+    CHECK(detail::transform_in_range<std::int16_t>(shift_transform(-17)));
+    CHECK(detail::transform_in_range<std::int32_t>(identity_transform()));
+    CHECK_FALSE(detail::transform_in_range<std::int32_t>(y_flip_transform(4096)));
+    CHECK(detail::transform_in_range<double>(scale_transform(3.0f)));
+
+    auto const paths = f.getGeometries<points_arrays_type>(1.0);
+    REQUIRE(paths.size() == 1);
+    REQUIRE(paths[0].size() == 5);
+    REQUIRE(paths[0][1].x == 30000);
+    REQUIRE(paths[0][4].x == 0);
+    REQUIRE(paths[0][4].y == 4);
+    REQUIRE_THROWS_WITH(f.getGeometries<points_arrays_type>(1.1f), "paths outside valid range of coordinate_type");
+
+    // The proof holds for int32 coordinates, points past int32 still throw
+    using int_lines = mapbox::geometry::multi_line_string<std::int32_t>;
+    feature const g(lyr.getFeature(1), lyr);
+    REQUIRE_THROWS_WITH(g.getGeometries<int_lines>(identity_transform()), "paths outside valid range of coordinate_type");
+    REQUIRE_THROWS_WITH(g.getGeometry<std::int32_t>(), "paths outside valid range of coordinate_type");
+}
+
+// Geometry collection remembering the largest reservation getGeometries
+// asks for, on the collection or on any path in it
+static std::size_t largest_reserve = 0;
+
+struct reserve_recording_path : std::vector<mapbox::geometry::point<std::int32_t>> {
+    using coordinate_type = std::int32_t;
+    void reserve(std::size_t n) {
+        largest_reserve = std::max(largest_reserve, n);
+        std::vector<mapbox::geometry::point<std::int32_t>>::reserve(n);
+    }
+};
+
+struct reserve_recording_paths : std::vector<reserve_recording_path> {
+    using coordinate_type = std::int32_t;
+    void reserve(std::size_t n) {
+        largest_reserve = std::max(largest_reserve, n);
+        std::vector<reserve_recording_path>::reserve(n);
+    }
+};
+
+TEST_CASE( "Each geometry type reserves exactly what it decodes" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.features = {encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 3), zigzag(1), zigzag(1),
+                                                       zigzag(1), zigzag(1), zigzag(1), zigzag(1)}),
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1),
+                                                            command(CommandType::LINE_TO, 2), zigzag(1), zigzag(0), zigzag(0), zigzag(1)}),
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                         command(CommandType::LINE_TO, 2), zigzag(4), zigzag(0), zigzag(0), zigzag(4),
+                                                         command(CommandType::CLOSE, 1)})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+
+    auto const points = feature(lyr.getFeature(0), lyr).getGeometries<points_arrays_type>(1.0);
+    REQUIRE(points.size() == 3);
+    REQUIRE(points.capacity() == 3);
+    REQUIRE(points[2][0].x == 3);
+
+    auto const line = feature(lyr.getFeature(1), lyr).getGeometries<points_arrays_type>(1.0);
+    REQUIRE(line.size() == 1);
+    REQUIRE(line[0].size() == 3);
+    REQUIRE(line[0].capacity() == 3);
+
+    auto const polygon = feature(lyr.getFeature(2), lyr).getGeometries<points_arrays_type>(1.0);
+    REQUIRE(polygon.size() == 1);
+    REQUIRE(polygon[0].size() == 4);
+    REQUIRE(polygon[0].capacity() == 4);
+    REQUIRE(polygon[0][3].x == 0);
+    REQUIRE(polygon[0][3].y == 0);
+
+    // A command count larger than the geometry could hold is not reserved:
+    // every point takes at least two bytes
+    std::vector<std::uint32_t> const bogus_point = {command(CommandType::MOVE_TO, (1u << 29) - 1), zigzag(1), zigzag(1)};
+    std::vector<std::uint32_t> const bogus_line = {command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1),
+                                                   command(CommandType::LINE_TO, (1u << 29) - 1), zigzag(1), zigzag(1)};
+    std::string const bogus = encode_tile({[&] {
+        test_layer b;
+        b.features = {encode_feature(GeomType::POINT, {}, bogus_point),
+                      encode_feature(GeomType::LINESTRING, {}, bogus_line),
+                      encode_feature(GeomType::POLYGON, {}, bogus_line)};
+        return b;
+    }()});
+    buffer bogus_tile(bogus);
+    auto const bogus_layer = bogus_tile.getLayer("layer_name");
+    auto const bogus_points = feature(bogus_layer.getFeature(0), bogus_layer).getGeometries<points_arrays_type>(1.0);
+    REQUIRE(bogus_points.size() == 1);
+    for (std::size_t i = 0; i < bogus_layer.featureCount(); ++i) {
+        largest_reserve = 0;
+        feature const f(bogus_layer.getFeature(i), bogus_layer);
+        auto const paths = f.getGeometries<reserve_recording_paths>(identity_transform());
+        REQUIRE(paths.size() == 1);
+        CHECK(largest_reserve > 0);
+        // Half the geometry's bytes plus the MoveTo and closing points,
+        // the packed fields being 7 and 10 bytes long
+        CHECK(largest_reserve <= 7);
+        CHECK(paths.capacity() == paths.size());
+        CHECK(paths[0].capacity() == paths[0].size());
+    }
+}
+
+TEST_CASE( "Bounding boxes without materializing geometries" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.features = {encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 2), zigzag(5), zigzag(-3), zigzag(-10), zigzag(7)}),
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                         command(CommandType::LINE_TO, 2), zigzag(4096), zigzag(0), zigzag(0), zigzag(-128),
+                                                         command(CommandType::CLOSE, 1)}),
+                  encode_feature(GeomType::LINESTRING, {}, {})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+
+    auto const points = feature(lyr.getFeature(0), lyr).getBBox();
+    CHECK(points.min.x == -5);
+    CHECK(points.min.y == -3);
+    CHECK(points.max.x == 5);
+    CHECK(points.max.y == 4);
+
+    std::vector<bbox_type> boxes;
+    lyr.getBBoxes(boxes);
+    REQUIRE(boxes.size() == 3);
+    CHECK(boxes[0].min.x == points.min.x);
+    CHECK(boxes[0].max.y == points.max.y);
+    CHECK(boxes[1].min.x == 0);
+    CHECK(boxes[1].min.y == -128);
+    CHECK(boxes[1].max.x == 4096);
+    CHECK(boxes[1].max.y == 0);
+    // Nothing to bound
+    CHECK(boxes[2].min.x > boxes[2].max.x);
+    CHECK(boxes[2].min.y > boxes[2].max.y);
+
+    // Matches the points getGeometries decodes
+    feature const polygon(lyr.getFeature(1), lyr);
+    for (auto const& ring : polygon.getGeometries<mapbox::geometry::multi_line_string<std::int32_t>>(identity_transform())) {
+        for (auto const& p : ring) {
+            CHECK(p.x >= boxes[1].min.x);
+            CHECK(p.x <= boxes[1].max.x);
+            CHECK(p.y >= boxes[1].min.y);
+            CHECK(p.y <= boxes[1].max.y);
+        }
+    }
+}
+
+TEST_CASE( "Query features by bounding box" ) {
+    using namespace mapbox::vector_tile;
+    // A 20x20 lattice of small squares 200 units apart, plus one polygon
+    // covering the whole tile and a feature without geometry
+    test_layer l;
+    for (std::int32_t row = 0; row < 20; ++row) {
+        for (std::int32_t col = 0; col < 20; ++col) {
+            l.features.push_back(encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(col * 200), zigzag(row * 200),
+                                                                        command(CommandType::LINE_TO, 3), zigzag(10), zigzag(0), zigzag(0), zigzag(10), zigzag(-10), zigzag(0),
+                                                                        command(CommandType::CLOSE, 1)}));
+        }
+    }
+    l.features.push_back(encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                                command(CommandType::LINE_TO, 2), zigzag(4096), zigzag(0), zigzag(0), zigzag(4096),
+                                                                command(CommandType::CLOSE, 1)}));
+    l.features.push_back(encode_feature(GeomType::POINT, {}, {}));
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto lyr = tile.getLayer("layer_name");
+
+    std::vector<bbox_type> boxes;
+    lyr.getBBoxes(boxes);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<std::int32_t> coordinate(-100, 4200);
+    std::vector<std::size_t> found;
+    std::vector<std::size_t> unindexed;
+    // Every query runs against the plain layer, then against its index
+    REQUIRE_FALSE(lyr.isIndexed());
+    layer const plain = lyr;
+    lyr.buildIndex();
+    REQUIRE(lyr.isIndexed());
+    REQUIRE_FALSE(plain.isIndexed());
+    for (int q = 0; q < 200; ++q) {
+        std::int32_t x0 = coordinate(rng);
+        std::int32_t x1 = coordinate(rng);
+        std::int32_t y0 = coordinate(rng);
+        std::int32_t y1 = coordinate(rng);
+        bbox_type const box({std::min(x0, x1), std::min(y0, y1)}, {std::max(x0, x1), std::max(y0, y1)});
+        std::vector<std::size_t> expected;
+        for (std::size_t i = 0; i < boxes.size(); ++i) {
+            if (!(boxes[i].max.x < box.min.x || boxes[i].min.x > box.max.x ||
+                  boxes[i].max.y < box.min.y || boxes[i].min.y > box.max.y)) {
+                expected.push_back(i);
+            }
+        }
+        lyr.queryBBox(box, found);
+        REQUIRE(found == expected);
+        plain.queryBBox(box, unindexed);
+        REQUIRE(unindexed == expected);
+    }
+
+    // Edges touch
+    lyr.queryBBox(bbox_type({210, 210}, {210, 210}), found);
+    REQUIRE(found == std::vector<std::size_t>({21, 400}));
+    lyr.queryBBox(bbox_type({5000, 5000}, {6000, 6000}), found);
+    REQUIRE(found.empty());
+    plain.queryBBox(bbox_type({210, 210}, {210, 210}), unindexed);
+    REQUIRE(unindexed == std::vector<std::size_t>({21, 400}));
+    plain.queryBBox(bbox_type({10, 10}, {5, 5}), unindexed);
+    REQUIRE(unindexed.empty());
+
+    // Copies of an indexed layer keep working
+    layer const copy = lyr;
+    copy.queryBBox(bbox_type({0, 0}, {5, 5}), found);
+    REQUIRE(found == std::vector<std::size_t>({0, 400}));
+}
+
+TEST_CASE( "Pick features under a point" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.features = {// 0: square (0,0)-(100,100) with a hole (40,40)-(60,60)
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                         command(CommandType::LINE_TO, 3), zigzag(100), zigzag(0), zigzag(0), zigzag(100), zigzag(-100), zigzag(0),
+                                                         command(CommandType::CLOSE, 1),
+                                                         command(CommandType::MOVE_TO, 1), zigzag(40), zigzag(-60),
+                                                         command(CommandType::LINE_TO, 3), zigzag(0), zigzag(20), zigzag(20), zigzag(0), zigzag(0), zigzag(-20),
+                                                         command(CommandType::CLOSE, 1)}),
+                  // 1: diagonal line (200,0)-(300,100)
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(200), zigzag(0),
+                                                            command(CommandType::LINE_TO, 1), zigzag(100), zigzag(100)}),
+                  // 2: points (10,10) and (500,500)
+                  encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 2), zigzag(10), zigzag(10), zigzag(490), zigzag(490)})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+
+    std::vector<std::size_t> found;
+    lyr.queryPoint(20, 20, 0.0, found);
+    CHECK(found == std::vector<std::size_t>({0}));
+    lyr.queryPoint(10, 10, 0.0, found);
+    CHECK(found == std::vector<std::size_t>({0, 2}));
+    lyr.queryPoint(50, 50, 0.0, found);
+    CHECK(found.empty());
+    // The hole's outline is within reach
+    lyr.queryPoint(50, 50, 10.0, found);
+    CHECK(found == std::vector<std::size_t>({0}));
+    lyr.queryPoint(104, 50, 3.0, found);
+    CHECK(found.empty());
+    lyr.queryPoint(104, 50, 4.0, found);
+    CHECK(found == std::vector<std::size_t>({0}));
+    // (260, 40) is 20 / sqrt(2) ~ 14.1 away from the line
+    lyr.queryPoint(260, 40, 14.0, found);
+    CHECK(found.empty());
+    lyr.queryPoint(260, 40, 14.2, found);
+    CHECK(found == std::vector<std::size_t>({1}));
+    lyr.queryPoint(503, 504, 5.0, found);
+    CHECK(found == std::vector<std::size_t>({2}));
+
+    std::vector<mapbox::geometry::point<std::int32_t>> const points = {{20, 20}, {10, 10}, {50, 50}, {260, 40}, {503, 504}, {-1000, -1000}};
+    std::vector<std::vector<std::size_t>> batch;
+    lyr.queryPoints(points, 14.2, batch);
+    REQUIRE(batch.size() == points.size());
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        lyr.queryPoint(points[i].x, points[i].y, 14.2, found);
+        CHECK(batch[i] == found);
+    }
+    CHECK(batch[3] == std::vector<std::size_t>({1}));
+    CHECK(batch[5].empty());
+
+    // One scratch buffer reused across calls gives the same answers, and
+    // `out` is always cleared first
+    query_buffer scratch;
+    std::vector<std::size_t> reused = {42};
+    std::vector<std::vector<std::size_t>> reused_batch = {{42}};
+    for (int round = 0; round < 2; ++round) {
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            lyr.queryPoint(points[i].x, points[i].y, 14.2, reused, scratch);
+            CHECK(reused == batch[i]);
+        }
+        lyr.queryPoints(points, 14.2, reused_batch, scratch);
+        CHECK(reused_batch == batch);
+    }
+}
+
+TEST_CASE( "Assemble multipolygons while decoding" ) {
+    using namespace mapbox::vector_tile;
+    // Exterior (0,0)-(10,10), a hole in it, a degenerate ring, then a
+    // second exterior ring (20,0)-(30,10)
+    std::vector<std::uint32_t> const geometry = {
+        command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+        command(CommandType::LINE_TO, 3), zigzag(10), zigzag(0), zigzag(0), zigzag(10), zigzag(-10), zigzag(0),
+        command(CommandType::CLOSE, 1),
+        command(CommandType::MOVE_TO, 1), zigzag(2), zigzag(-8),
+        command(CommandType::LINE_TO, 3), zigzag(0), zigzag(2), zigzag(2), zigzag(0), zigzag(0), zigzag(-2),
+        command(CommandType::CLOSE, 1),
+        command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+        command(CommandType::LINE_TO, 2), zigzag(1), zigzag(1), zigzag(1), zigzag(1),
+        command(CommandType::CLOSE, 1),
+        command(CommandType::MOVE_TO, 1), zigzag(14), zigzag(-4),
+        command(CommandType::LINE_TO, 3), zigzag(10), zigzag(0), zigzag(0), zigzag(10), zigzag(-10), zigzag(0),
+        command(CommandType::CLOSE, 1)};
+    test_layer l;
+    l.features = {encode_feature(GeomType::POLYGON, {}, geometry),
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                            command(CommandType::LINE_TO, 1), zigzag(1), zigzag(1)})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    feature const f(lyr.getFeature(0), lyr);
+
+    auto const polygons = f.getMultiPolygon<std::int32_t>();
+    REQUIRE(polygons.size() == 2);
+    REQUIRE(polygons[0].size() == 2);
+    REQUIRE(polygons[0][0].size() == 5);
+    CHECK(polygons[0][0].front().x == polygons[0][0].back().x);
+    CHECK(polygons[0][0].front().y == polygons[0][0].back().y);
+    CHECK(polygons[0][1][0].x == 2);
+    CHECK(polygons[0][1][0].y == 2);
+    REQUIRE(polygons[1].size() == 1);
+    CHECK(polygons[1][0][0].x == 20);
+    CHECK(polygons[1][0][0].y == 0);
+
+    // Same rings as getGeometries, minus the degenerate one
+    auto const rings = f.getGeometries<points_arrays_type>(1.0);
+    REQUIRE(rings.size() == 4);
+    for (std::size_t i = 0; i < rings[3].size(); ++i) {
+        CHECK(polygons[1][0][i].x == rings[3][i].x);
+        CHECK(polygons[1][0][i].y == rings[3][i].y);
+    }
+
+    auto const scaled = f.getMultiPolygon<double>(affine_transform(0.5, 0.0, 0.0));
+    CHECK(scaled[1][0][1].x == Approx(15.0));
+
+    CHECK(feature(lyr.getFeature(1), lyr).getMultiPolygon<std::int32_t>().empty());
+}
+
+TEST_CASE( "Decode into mapbox::geometry types" ) {
+    using namespace mapbox::vector_tile;
+    std::vector<std::uint32_t> const square = {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                               command(CommandType::LINE_TO, 3), zigzag(10), zigzag(0), zigzag(0), zigzag(10), zigzag(-10), zigzag(0),
+                                               command(CommandType::CLOSE, 1)};
+    std::vector<std::uint32_t> two_squares = square;
+    two_squares.push_back(command(CommandType::MOVE_TO, 1));
+    two_squares.push_back(zigzag(20));
+    two_squares.push_back(zigzag(-10));
+    two_squares.insert(two_squares.end(), square.begin() + 3, square.end());
+    test_layer l;
+    l.features = {encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 1), zigzag(3), zigzag(4)}),
+                  encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 2), zigzag(3), zigzag(4), zigzag(1), zigzag(1)}),
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                            command(CommandType::LINE_TO, 2), zigzag(5), zigzag(0), zigzag(0), zigzag(5)}),
+                  // The second line has a single point and is dropped
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                            command(CommandType::LINE_TO, 1), zigzag(5), zigzag(0),
+                                                            command(CommandType::MOVE_TO, 1), zigzag(5), zigzag(5),
+                                                            command(CommandType::MOVE_TO, 1), zigzag(1), zigzag(1),
+                                                            command(CommandType::LINE_TO, 1), zigzag(1), zigzag(1)}),
+                  encode_feature(GeomType::POLYGON, {}, square),
+                  encode_feature(GeomType::POLYGON, {}, two_squares),
+                  encode_feature(GeomType::UNKNOWN, {}, {})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    auto const geometry = [&lyr](std::size_t i) {
+        return feature(lyr.getFeature(i), lyr).getGeometry<std::int32_t>();
+    };
+
+    auto const point = geometry(0);
+    REQUIRE(point.is<mapbox::geometry::point<std::int32_t>>());
+    CHECK(point.get<mapbox::geometry::point<std::int32_t>>().x == 3);
+
+    auto const points = geometry(1);
+    REQUIRE(points.is<mapbox::geometry::multi_point<std::int32_t>>());
+    CHECK(points.get<mapbox::geometry::multi_point<std::int32_t>>().size() == 2);
+    CHECK(points.get<mapbox::geometry::multi_point<std::int32_t>>()[1].y == 5);
+
+    auto const line = geometry(2);
+    REQUIRE(line.is<mapbox::geometry::line_string<std::int32_t>>());
+    CHECK(line.get<mapbox::geometry::line_string<std::int32_t>>().size() == 3);
+    CHECK(line.get<mapbox::geometry::line_string<std::int32_t>>().capacity() == 3);
+
+    auto const lines = geometry(3);
+    REQUIRE(lines.is<mapbox::geometry::multi_line_string<std::int32_t>>());
+    auto const& parts = lines.get<mapbox::geometry::multi_line_string<std::int32_t>>();
+    REQUIRE(parts.size() == 2);
+    CHECK(parts[1][0].x == 11);
+    CHECK(parts[1][1].x == 12);
+
+    auto const polygon = geometry(4);
+    REQUIRE(polygon.is<mapbox::geometry::polygon<std::int32_t>>());
+    CHECK(polygon.get<mapbox::geometry::polygon<std::int32_t>>()[0].size() == 5);
+    CHECK(polygon.get<mapbox::geometry::polygon<std::int32_t>>()[0].capacity() == 5);
+
+    auto const polygons = geometry(5);
+    REQUIRE(polygons.is<mapbox::geometry::multi_polygon<std::int32_t>>());
+    CHECK(polygons.get<mapbox::geometry::multi_polygon<std::int32_t>>()[1][0][0].x == 20);
+
+    CHECK(geometry(6).is<mapbox::geometry::empty>());
+
+    auto const scaled = feature(lyr.getFeature(0), lyr).getGeometry<double>(affine_transform(0.5, 1.0, 0.0));
+    CHECK(scaled.get<mapbox::geometry::point<double>>().x == Approx(3.0));
+    CHECK(scaled.get<mapbox::geometry::point<double>>().y == Approx(2.0));
+}
+
+TEST_CASE( "Clip geometries while decoding" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.features = {encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 3), zigzag(5), zigzag(5), zigzag(20), zigzag(0), zigzag(-15), zigzag(5)}),
+                  // (-10,5) -> (20,5) -> (20,8) -> (5,8): in, out, back in
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(-10), zigzag(5),
+                                                            command(CommandType::LINE_TO, 3), zigzag(30), zigzag(0), zigzag(0), zigzag(3), zigzag(-15), zigzag(0)}),
+                  // Square (-10,-10)-(20,20) covering the whole clip box
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(-10), zigzag(-10),
+                                                         command(CommandType::LINE_TO, 3), zigzag(30), zigzag(0), zigzag(0), zigzag(30), zigzag(-30), zigzag(0),
+                                                         command(CommandType::CLOSE, 1)}),
+                  // Triangle entirely outside
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(100), zigzag(100),
+                                                         command(CommandType::LINE_TO, 2), zigzag(10), zigzag(0), zigzag(0), zigzag(10),
+                                                         command(CommandType::CLOSE, 1)}),
+                  // (5,5) -> (10,5) -> (15,5) -> (15,8): leaves from a point on the edge
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(5), zigzag(5),
+                                                            command(CommandType::LINE_TO, 3), zigzag(5), zigzag(0), zigzag(5), zigzag(0), zigzag(0), zigzag(3)})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+    bbox_type const clip({0, 0}, {10, 10});
+
+    geometry_buffer points;
+    feature(lyr.getFeature(0), lyr).decodeClippedGeometry(clip, points);
+    CHECK(points.x == std::vector<std::int32_t>({5, 10}));
+    CHECK(points.y == std::vector<std::int32_t>({5, 10}));
+
+    geometry_buffer lines;
+    feature(lyr.getFeature(1), lyr).decodeClippedGeometry(clip, lines);
+    REQUIRE(lines.ringCount() == 2);
+    CHECK(lines.x == std::vector<std::int32_t>({0, 10, 10, 5}));
+    CHECK(lines.y == std::vector<std::int32_t>({5, 5, 8, 8}));
+
+    auto const square = feature(lyr.getFeature(2), lyr).getClippedGeometry<std::int32_t>(clip);
+    REQUIRE(square.is<mapbox::geometry::polygon<std::int32_t>>());
+    auto const& ring = square.get<mapbox::geometry::polygon<std::int32_t>>().at(0);
+    REQUIRE(ring.size() == 5);
+    for (auto const& p : ring) {
+        CHECK((p.x == 0 || p.x == 10));
+        CHECK((p.y == 0 || p.y == 10));
+    }
+    CHECK(ring.front().x == ring.back().x);
+    CHECK(ring.front().y == ring.back().y);
+
+    CHECK(feature(lyr.getFeature(3), lyr).getClippedGeometry<std::int32_t>(clip).is<mapbox::geometry::empty>());
+
+    // The edge point is not repeated when the line leaves from it
+    auto const edge = feature(lyr.getFeature(4), lyr).getClippedGeometry<std::int32_t>(clip);
+    REQUIRE(edge.is<mapbox::geometry::line_string<std::int32_t>>());
+    CHECK(edge.get<mapbox::geometry::line_string<std::int32_t>>() ==
+          mapbox::geometry::line_string<std::int32_t>({{5, 5}, {10, 5}}));
+
+    // A clip box around the whole geometry changes nothing
+    bbox_type const everything({-1000, -1000}, {1000, 1000});
+    for (std::size_t i = 0; i < lyr.featureCount(); ++i) {
+        feature const f(lyr.getFeature(i), lyr);
+        geometry_buffer clipped;
+        geometry_buffer full;
+        f.decodeClippedGeometry(everything, clipped);
+        f.decodeGeometry(full);
+        CHECK(clipped.x == full.x);
+        CHECK(clipped.y == full.y);
+        CHECK(clipped.rings == full.rings);
+    }
+}
+
+TEST_CASE( "Simplify geometries while decoding" ) {
+    using namespace mapbox::vector_tile;
+    // A line along y = 0 with wiggles of 1 unit, a repeated point and one
+    // spike of 50 units
+    std::vector<std::uint32_t> line = {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                       command(CommandType::LINE_TO, 101)};
+    std::int32_t y = 0;
+    for (std::int32_t i = 1; i <= 100; ++i) {
+        std::int32_t const target = i == 50 ? 50 : i % 2;
+        line.push_back(zigzag(10));
+        line.push_back(zigzag(target - y));
+        y = target;
+        if (i == 30) {
+            line.push_back(zigzag(0));
+            line.push_back(zigzag(0));
+        }
+    }
+    test_layer l;
+    l.features = {encode_feature(GeomType::LINESTRING, {}, line),
+                  // A square with extra points along its edges
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                         command(CommandType::LINE_TO, 7), zigzag(50), zigzag(1), zigzag(50), zigzag(-1),
+                                                         zigzag(0), zigzag(100), zigzag(-50), zigzag(1), zigzag(-50), zigzag(-1),
+                                                         zigzag(1), zigzag(-50), zigzag(-1), zigzag(-50),
+                                                         command(CommandType::CLOSE, 1)}),
+                  // A small triangle that would collapse
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                         command(CommandType::LINE_TO, 2), zigzag(2), zigzag(0), zigzag(0), zigzag(2),
+                                                         command(CommandType::CLOSE, 1)})};
+    std::string const data = encode_tile({l});
+    buffer tile(data);
+    auto const lyr = tile.getLayer("layer_name");
+
+    geometry_buffer full;
+    feature(lyr.getFeature(0), lyr).decodeGeometry(full);
+    REQUIRE(full.pointCount() == 102);
+
+    geometry_buffer simplified;
+    feature(lyr.getFeature(0), lyr).decodeSimplifiedGeometry(2.0, simplified);
+    // The ends and the spike, where the foot of its rising side is as far
+    // from (0,0)-(500,50) as (490,1) and comes first
+    CHECK(simplified.x == std::vector<std::int32_t>({0, 480, 490, 500, 510, 1000}));
+    CHECK(simplified.y == std::vector<std::int32_t>({0, 0, 1, 50, 1, 0}));
+
+    // Nothing but the repeated point is dropped under a zero tolerance
+    geometry_buffer exact;
+    feature(lyr.getFeature(0), lyr).decodeSimplifiedGeometry(0.0, exact);
+    CHECK(exact.pointCount() == 101);
+
+    auto const square = feature(lyr.getFeature(1), lyr).getSimplifiedGeometries<points_arrays_type>(2.0, 1.0);
+    REQUIRE(square.size() == 1);
+    REQUIRE(square[0].size() == 5);
+    CHECK(square[0][1].x == 100);
+    CHECK(square[0][1].y == 0);
+    CHECK(square[0][4].x == 0);
+    CHECK(square[0][4].y == 0);
+
+    auto const triangle = feature(lyr.getFeature(2), lyr).getSimplifiedGeometries<points_arrays_type>(10.0, 1.0);
+    REQUIRE(triangle.size() == 1);
+    CHECK(triangle[0].size() == 4);
+
+    // Unit and power of two scales are exact like getGeometries, even past
+    // the 2^24 a float holds exactly
+    test_layer wide;
+    wide.features = {encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(16777217), zigzag(0),
+                                                               command(CommandType::LINE_TO, 2), zigzag(16777218), zigzag(0), zigzag(0), zigzag(5)})};
+    std::string const wide_data = encode_tile({wide});
+    buffer const wide_tile(wide_data);
+    auto const wide_layer = wide_tile.getLayer("layer_name");
+    feature const far(wide_layer.getFeature(0), wide_layer);
+    using int_lines = mapbox::geometry::multi_line_string<std::int32_t>;
+    for (float const scale : {1.0f, 2.0f, 0.5f}) {
+        CHECK(far.getSimplifiedGeometries<int_lines>(0.0, scale) == far.getGeometries<int_lines>(scale));
+    }
+    auto const unit = far.getSimplifiedGeometries<int_lines>(0.0, 1.0);
+    REQUIRE(unit.size() == 1);
+    REQUIRE(unit[0].size() == 3);
+    CHECK(unit[0][0].x == 16777217);
+    CHECK(unit[0][1].x == 33554435);
+}
+
+TEST_CASE( "Overzoom a child tile out of its parent" ) {
+    using namespace mapbox::vector_tile;
+    test_layer l;
+    l.keys = {"name"};
+    l.values = {string_value("a")};
+    // Points at (1000,1000) and (3000,3000)
+    l.features = {encode_feature(GeomType::POINT, {0, 0}, {command(CommandType::MOVE_TO, 2), zigzag(1000), zigzag(1000), zigzag(2000), zigzag(2000)}, 7),
+                  // (1000,1000) -> (3000,1000)
+                  encode_feature(GeomType::LINESTRING, {}, {command(CommandType::MOVE_TO, 1), zigzag(1000), zigzag(1000),
+                                                            command(CommandType::LINE_TO, 1), zigzag(2000), zigzag(0)}),
+                  // The whole parent tile
+                  encode_feature(GeomType::POLYGON, {}, {command(CommandType::MOVE_TO, 1), zigzag(0), zigzag(0),
+                                                         command(CommandType::LINE_TO, 3), zigzag(4096), zigzag(0), zigzag(0), zigzag(4096), zigzag(-4096), zigzag(0),
+                                                         command(CommandType::CLOSE, 1)})};
+    test_layer other;
+    other.name = "other";
+    other.features = {encode_feature(GeomType::POINT, {}, {command(CommandType::MOVE_TO, 1), zigzag(3000), zigzag(3000)})};
+    std::string const data = encode_tile({l, other});
+
+    std::string const top_left = overzoom(data, 1, 0, 0);
+    buffer tile(top_left);
+    REQUIRE(tile.layerNames() == std::vector<std::string>({"layer_name"}));
+    auto const lyr = tile.getLayer("layer_name");
+    CHECK(lyr.getExtent() == 4096);
+    CHECK(lyr.getVersion() == 2);
+    REQUIRE(lyr.featureCount() == 3);
+
+    feature const point(lyr.getFeature(0), lyr);
+    CHECK(point.getType() == GeomType::POINT);
+    CHECK(point.getID().get<std::uint64_t>() == 7);
+    CHECK(point.getValue("name").get<std::string>() == "a");
+    geometry_buffer points;
+    point.decodeGeometry(points);
+    CHECK(points.x == std::vector<std::int32_t>({2000}));
+    CHECK(points.y == std::vector<std::int32_t>({2000}));
+
+    // Clipped to the tile plus the default 64 unit buffer
+    geometry_buffer line;
+    feature(lyr.getFeature(1), lyr).decodeGeometry(line);
+    CHECK(line.x == std::vector<std::int32_t>({2000, 4160}));
+    CHECK(line.y == std::vector<std::int32_t>({2000, 2000}));
+
+    auto const square = feature(lyr.getFeature(2), lyr).getGeometries<points_arrays_type>(1.0);
+    REQUIRE(square.size() == 1);
+    REQUIRE(square[0].size() == 5);
+    for (auto const& p : square[0]) {
+        CHECK((p.x == 0 || p.x == 4160));
+        CHECK((p.y == 0 || p.y == 4160));
+    }
+
+    // The bottom right child, with a smaller extent and no buffer
+    overzoom_options options;
+    options.extent = 512;
+    options.buffer = 0;
+    std::string const bottom_right = overzoom(data, 1, 1, 1, options);
+    buffer child(bottom_right);
+    REQUIRE(child.layerNames() == std::vector<std::string>({"layer_name", "other"}));
+    auto const child_layer = child.getLayer("layer_name");
+    CHECK(child_layer.getExtent() == 512);
+    // The line is in the top half
+    REQUIRE(child_layer.featureCount() == 2);
+    geometry_buffer child_point;
+    feature(child_layer.getFeature(0), child_layer).decodeGeometry(child_point);
+    CHECK(child_point.x == std::vector<std::int32_t>({238}));
+    CHECK(child_point.y == std::vector<std::int32_t>({238}));
+
+    // Zooming in by zero levels keeps every geometry
+    std::string const same = overzoom(data, 0, 0, 0);
+    buffer const parent(data);
+    buffer const copy(same);
+    auto const parent_layer = parent.getLayer("layer_name");
+    auto const copy_layer = copy.getLayer("layer_name");
+    REQUIRE(copy_layer.featureCount() == 3);
+    for (std::size_t i = 0; i < copy_layer.featureCount(); ++i) {
+        CHECK(feature(copy_layer.getFeature(i), copy_layer).getGeometries<points_arrays_type>(1.0) ==
+              feature(parent_layer.getFeature(i), parent_layer).getGeometries<points_arrays_type>(1.0));
+    }
+
+    REQUIRE_THROWS_WITH(overzoom(data, 1, 2, 0), "invalid child tile address");
+
+    // The child layer is named like buffer::getLayer names the parent layer
+    std::string renamed;
+    {
+        protozero::pbf_writer tile_writer(renamed);
+        protozero::pbf_writer layer_writer(tile_writer, TileType::LAYERS);
+        layer_writer.add_string(LayerType::NAME, "old");
+        layer_writer.add_uint32(LayerType::VERSION, 2);
+        layer_writer.add_uint32(LayerType::EXTENT, 4096);
+        layer_writer.add_message(LayerType::FEATURES, l.features[0]);
+        layer_writer.add_string(LayerType::NAME, "new");
+    }
+    std::string const renamed_data = overzoom(renamed, 0, 0, 0);
+    buffer const renamed_child(renamed_data);
+    CHECK(renamed_child.layerNames() == buffer(renamed).layerNames());
+    CHECK(renamed_child.layerNames() == std::vector<std::string>({"new"}));
+
+    // A parent layer that buffer::getLayer rejects is rejected here too
+    std::string incomplete;
+    {
+        protozero::pbf_writer tile_writer(incomplete);
+        protozero::pbf_writer layer_writer(tile_writer, TileType::LAYERS);
+        layer_writer.add_string(LayerType::NAME, "incomplete");
+        layer_writer.add_message(LayerType::FEATURES, l.features[0]);
+    }
+    REQUIRE_THROWS_WITH(buffer(incomplete).getLayer("incomplete"), "missing required field: version  extent ");
+    REQUIRE_THROWS_WITH(overzoom(incomplete, 0, 0, 0), "missing required field: version  extent ");
+
+    // Child coordinates and deltas must fit the int32 the encoding carries,
+    // whether a huge extent or a huge buffer would take them past it
+    overzoom_options wide;
+    wide.extent = 3000000000u;
+    REQUIRE_THROWS_WITH(overzoom(data, 0, 0, 0, wide), "overzoom extent and buffer exceed the coordinate range");
+    overzoom_options padded;
+    padded.buffer = 1u << 30;
+    REQUIRE_THROWS_WITH(overzoom(data, 0, 0, 0, padded), "overzoom extent and buffer exceed the coordinate range");
+    padded.buffer = (std::numeric_limits<std::int32_t>::max() - 4096) / 2;
+    std::string const padded_data = overzoom(data, 0, 0, 0, padded);
+    buffer const padded_tile(padded_data);
+    REQUIRE(padded_tile.getLayer("layer_name").featureCount() == 3);
+
+    // Scaling an extent of 1 up to 2^30 units, 2^24 times over, takes
+    // (1000,1000) past the int64 range
+    test_layer tiny;
+    tiny.extent = 1;
+    tiny.features = {l.features[0]};
+    overzoom_options huge;
+    huge.extent = 1u << 30;
+    REQUIRE_THROWS_WITH(overzoom(encode_tile({tiny}), 24, 0, 0, huge), "overzoomed coordinate out of range");
+}